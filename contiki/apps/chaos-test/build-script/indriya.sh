@@ -17,3 +17,9 @@ do
 	make chaos-test.sky TARGET=sky DEFINES=TESTBED=${testbed},INITIATOR_NODE_ID=${sink},CC2420_TXPOWER=${pw})	
 	cp ../chaos-test.sky ${dir}/ct_${testbed}_pw${pw}_sink${sink}.exe
 done
+
+# adaptive transmit power
+(cd ..
+make clean
+make chaos-test.sky TARGET=sky DEFINES=TESTBED=${testbed},INITIATOR_NODE_ID=${sink},CHAOS_POWER_CONTROL=1)
+cp ../chaos-test.sky ${dir}/ct_${testbed}_pwadaptive_sink${sink}.exe
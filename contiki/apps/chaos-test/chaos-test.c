@@ -102,6 +102,12 @@
 
 #include "chaos-test.h"
 #include "chaos.h"
+#include "chaos-agree.h"
+#include "chaos-abcast.h"
+#include "chaos-member.h"
+#include "chaos-sched.h"
+#include "chaos-nc.h"
+#include "chaos-time.h"
 
 /**
  * \defgroup chaos-test-variables Application variables
@@ -113,7 +119,6 @@
  * @{
  */
 
-static chaos_data_struct chaos_data;     /**< \brief Flooding data. */
 static struct rtimer rt;                   /**< \brief Rtimer used to schedule Chaos. */
 static struct pt pt;                       /**< \brief Protothread used to schedule Chaos. */
 static rtimer_clock_t t_ref_l_old = 0;     /**< \brief Reference time computed from the Chaos
@@ -126,6 +131,62 @@ static rtimer_clock_t t_start = 0;         /**< \brief Starting time (low-freque
                                                 of the last Chaos phase. */
 static int period_skew = 0;                /**< \brief Current estimation of clock skew over a period
                                                 of length \link CHAOS_PERIOD \endlink. */
+#if CHAOS_DRIFT_TRACKING
+static int32_t drift_q = 0;                /**< \brief Tracked clock skew over a period of length
+                                                \link CHAOS_PERIOD \endlink, in 1/256 low-frequency ticks. */
+static uint8_t drift_n = 0;                /**< \brief Measurements weighed by the drift tracker so far,
+                                                up to \link CHAOS_DRIFT_WINDOW \endlink. */
+static uint8_t drift_jumps = 0;            /**< \brief Consecutive measurements further than
+                                                \link CHAOS_DRIFT_JUMP \endlink from the tracked skew. */
+static uint8_t drift_measured = 0;         /**< \brief Not zero if Chaos computed the reference time
+                                                of the last phase. */
+static uint8_t drift_measured_old = 0;     /**< \brief Not zero if it did so in the phase before too. */
+static uint16_t ref_frac = 0;              /**< \brief Position of the reference time after its low-frequency
+                                                tick, in 1/256 ticks. */
+static uint16_t ref_frac_next = 0;         /**< \brief Predicted position of the next reference time
+                                                after its tick, in 1/256 ticks. */
+#endif /* CHAOS_DRIFT_TRACKING */
+#if CHAOS_FAST_JOIN
+static uint16_t join_phases = 0;           /**< \brief Bootstrapping phases spent asking for the schedule. */
+#endif /* CHAOS_FAST_JOIN */
+#if CHAOS_ADAPTIVE_GUARD
+static rtimer_clock_t guard = CHAOS_GUARD_TIME; /**< \brief Guard time of the current Chaos phase. */
+static rtimer_clock_t t_ref_predicted = 0; /**< \brief Reference time the current phase was scheduled for. */
+static uint8_t guard_armed = 0;            /**< \brief Not zero if the current phase was scheduled
+                                                from a predicted reference time. */
+static int16_t guard_err = 0;              /**< \brief Mean wake-up error, in 1/16 low-frequency ticks
+                                                (negative: the round started before it was predicted). */
+static uint16_t guard_dev = 0;             /**< \brief Mean absolute deviation of the wake-up error,
+                                                in 1/16 low-frequency ticks. */
+static uint8_t guard_n = 0;                /**< \brief Wake-up errors measured so far,
+                                                up to \link CHAOS_GUARD_SETTLE \endlink. */
+#define GUARD_TIME() guard
+#else
+#define GUARD_TIME() (CHAOS_GUARD_TIME * (1 + sync_missed))
+#endif /* CHAOS_ADAPTIVE_GUARD */
+#if CHAOS_CLUSTERED
+static struct pt cluster_pt;               /**< \brief Protothread of the local rounds of cluster heads. */
+static uint8_t cluster_lead = 0;           /**< \brief Not zero if the next phase starts with the local round
+                                                of the cluster, \link CHAOS_CLUSTER_LEAD \endlink earlier. */
+static uint8_t cluster_complete = 0;       /**< \brief Not zero if all members contributed to the last local round. */
+static uint8_t cluster_chunks[CHAOS_CHUNK_MAP_LEN]; /**< \brief Chunks of the aggregate of the cluster. */
+static uint16_t cluster_id = 0;            /**< \brief Cluster of the node. */
+#endif /* CHAOS_CLUSTERED */
+#if CHAOS_EARLY_STOP
+static volatile uint8_t phase_end_armed = 0; /**< \brief Not zero while the end of the current Chaos
+                                                phase may be moved earlier. */
+#endif /* CHAOS_EARLY_STOP */
+#if CHAOS_MULTI_INITIATOR
+static uint8_t failover_active = 0;        /**< \brief Not zero if the node started a round because
+                                                nobody else did, and keeps doing so. */
+static uint8_t initiated = 0;              /**< \brief Not zero if the node started the last round. */
+static rtimer_clock_t failover_wait = 0;   /**< \brief Time a candidate other than the initiator waits
+                                                beyond the expected reference time before starting the round. */
+static uint16_t failover_wait_dco = 0;     /**< \brief Rest of that time below one low-frequency tick,
+                                                in DCO ticks. */
+static uint16_t boot_missed = 0;           /**< \brief Current number of consecutive bootstrapping
+                                                phases without any reception. */
+#endif /* CHAOS_MULTI_INITIATOR */
 
 /** @} */
 
@@ -139,8 +200,27 @@ static unsigned long packets_missed = 0;   /**< \brief Current number of missed
 static unsigned long latency = 0;          /**< \brief Latency of last Chaos phase, in us. */
 static unsigned long sum_latency = 0;      /**< \brief Current sum of latencies, in ticks of low-frequency
                                                 clock (used to compute average). */
+#if CHAOS_BURST > 1
+static unsigned long burst_completed = 0;  /**< \brief Current number of logical rounds of bursts
+                                                completed before moving to the next one. */
+#endif /* CHAOS_BURST */
+
+/** @} */
+
+#if CHAOS_POWER_CONTROL
+/**
+ * \defgroup chaos-test-variables-power Transmit power control variables
+ * @{
+ */
+
+static const uint8_t power_levels[] = {3, 7, 11, 15, 19, 23, 27, 31}; /**< \brief PA_LEVEL values from the
+                                                                        CC2420 data sheet. */
+#define POWER_LEVELS sizeof(power_levels)
+static uint8_t power_idx = POWER_LEVELS - 1; /**< \brief Current entry of power_levels. */
+static uint8_t power_hold = 0;             /**< \brief Consecutive rounds completed in time. */
 
 /** @} */
+#endif /* CHAOS_POWER_CONTROL */
 /** @} */
 
 /**
@@ -165,14 +245,14 @@ PROCESS_THREAD(chaos_print_stats_process, ev, data)
 			if (get_rx_cnt()) {	// Packet received at least once.
 				// Increment number of successfully received packets.
 				packets_received++;
-				// Compute latency during last Chaos phase.
-				rtimer_clock_t lat = get_t_first_rx_l() - get_t_ref_l();
+				// Compute latency during last Chaos phase (from the channel check without synchronization).
+				rtimer_clock_t lat = get_t_first_rx_l() - (CHAOS_SYNC_MODE ? get_t_ref_l() : t_start);
 				// Add last latency to sum of latencies.
 				sum_latency += lat;
 				// Convert latency to microseconds.
 				latency = (unsigned long)(lat) * 1e6 / RTIMER_SECOND;
 				// Print information about last packet and related latency.
-				printf("seq_no %lu\n", chaos_data.seq_no);
+				printf("seq_no %lu\n", CHAOS_DATA->seq_no);
 			} else {	// Packet not received.
 				// Increment number of missed packets.
 				packets_missed++;
@@ -181,9 +261,86 @@ PROCESS_THREAD(chaos_print_stats_process, ev, data)
 			}
 #if CHAOS_DEBUG
 //			printf("skew %ld ppm\n", (long)(period_skew * 1e6) / CHAOS_PERIOD);
+#if CHAOS_DRIFT_TRACKING
+			// 1e6 / 256 = 15625 / 4
+			printf("drift %ld ppm, n %u\n", (long)(drift_q * 15625L / ((long)CHAOS_PERIOD * 4)), drift_n);
+#endif /* CHAOS_DRIFT_TRACKING */
+#if CHAOS_ADAPTIVE_GUARD
+			printf("guard %u, err %d/16, dev %u/16, n %u\n", guard, guard_err, guard_dev, guard_n);
+#endif /* CHAOS_ADAPTIVE_GUARD */
+#if CHAOS_GLOBAL_TIME
+			if (chaos_time_valid()) {
+				printf("global time %lu\n", (unsigned long)chaos_global_time());
+			}
+#endif /* CHAOS_GLOBAL_TIME */
 			printf("high_T_irq %u, rx_timeout %u, bad_length %u, bad_header %u, bad_crc %u, T_slot_h %u, rc_up %u\n",
 					high_T_irq, rx_timeout, bad_length, bad_header, bad_crc, get_T_slot_h(), rc_update);
+#if CHAOS_FEC
+			printf("fec_rescued %u\n", fec_rescued);
+#endif /* CHAOS_FEC */
+#if CHAOS_FLAGS_CRC
+			printf("flags_rescued %u\n", flags_rescued);
+#endif /* CHAOS_FLAGS_CRC */
 #endif /* CHAOS_DEBUG */
+#if CHAOS_BURST > 1
+			printf("burst round %u, completed %lu\n", get_burst_round(), burst_completed);
+#endif /* CHAOS_BURST */
+#if CHAOS_POWER_CONTROL
+			printf("tx power %u\n", power_levels[power_idx]);
+#endif /* CHAOS_POWER_CONTROL */
+#if CHAOS_MEMBERSHIP
+			printf("index %u\n", node_index);
+#endif /* CHAOS_MEMBERSHIP */
+#if CHAOS_CLUSTERED
+			if (IS_CLUSTER_HEAD()) {
+				printf("cluster %u complete %u\n", cluster_id, cluster_complete);
+			}
+#endif /* CHAOS_CLUSTERED */
+#if CHAOS_MERGE_OP == CHAOS_MERGE_TOPK
+			// Print the highest values and their nodes.
+			chaos_topk_entry *list = (chaos_topk_entry *)CHAOS_DATA->payload;
+			uint8_t k;
+			printf("topk");
+			for (k = 0; k < CHAOS_TOPK_K && list[k].node != CHAOS_TOPK_NONE; k++) {
+				printf(" %u:%u", list[k].node, list[k].value);
+			}
+			printf("\n");
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_HIST
+			// Print the number of nodes per bucket.
+			uint8_t b;
+			uint16_t j;
+			printf("hist");
+			for (b = 0; b < CHAOS_HIST_BUCKETS; b++) {
+				uint16_t cnt = 0;
+				for (j = 0; j < MERGE_LEN * 8; j++) {
+					cnt += (CHAOS_DATA->payload[b * MERGE_LEN + j / 8] >> (j % 8)) & 1;
+				}
+				printf(" %u", cnt);
+			}
+			printf("\n");
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+			// Print each section of CHAOS_MUX_SECTIONS: bits set in bitmaps (nodes present in
+			// the ones that must be full), highest value of maxima.
+			const chaos_mux_section *sec;
+			uint16_t j, cnt;
+			printf("mux");
+			for (sec = chaos_mux_sections; sec < chaos_mux_sections + chaos_mux_sections_n; sec++) {
+				if (!CHAOS_MUX_SECTION_OK(sec)) {
+					printf(" -");
+				} else if (sec->op == CHAOS_MERGE_OR) {
+					cnt = 0;
+					for (j = 0; j < sec->len * 8; j++) {
+						cnt += (CHAOS_DATA->payload[sec->offset + j / 8] >> (j % 8)) & 1;
+					}
+					printf(" %s %u", (sec->done == CHAOS_MUX_DONE_FULL) ? "present" : "set", cnt);
+				} else if (sec->op == CHAOS_MERGE_MAX) {
+					printf(" max %u", CHAOS_DATA->payload[sec->offset]);
+				} else {
+					printf(" none");
+				}
+			}
+			printf("\n");
+#endif /* CHAOS_MERGE_OP */
 			// Compute current average reliability.
 			//unsigned long avg_rel = packets_received * 1e5 / (packets_received + packets_missed);
 			// Print information about average reliability.
@@ -225,11 +382,127 @@ PROCESS_THREAD(chaos_print_stats_process, ev, data)
  * @{
  */
 
+#if CHAOS_DRIFT_TRACKING
+static inline void drift_update(int32_t skew_q) {
+	int32_t diff = skew_q - drift_q;
+	if (drift_n == CHAOS_DRIFT_WINDOW && (diff > CHAOS_DRIFT_JUMP || diff < -CHAOS_DRIFT_JUMP)) {
+		if (++drift_jumps < 2) {
+			// A single bad reference time.
+			return;
+		}
+		// The drift itself changed (temperature): start over.
+		drift_n = 0;
+	}
+	drift_jumps = 0;
+	// Average of the measurements so far, then over the last CHAOS_DRIFT_WINDOW periods.
+	if (drift_n < CHAOS_DRIFT_WINDOW) {
+		drift_n++;
+	}
+	drift_q += (skew_q - drift_q) / drift_n;
+}
+
+static inline void track_drift(void) {
+	int32_t next_q;
+	uint16_t frac;
+	if (drift_measured) {
+		// Sub-tick position of the reference time computed by Chaos.
+		frac = ((uint32_t)(get_T_offset_h() + 1) << 8) / CLOCK_PHI;
+		if (drift_measured_old) {
+			// Skew over the last period, with fractions of a tick.
+			drift_update(((int32_t)(int)(get_t_ref_l() - (t_ref_l_old + (rtimer_clock_t)CHAOS_PERIOD)) << 8) +
+					frac - ref_frac);
+		}
+	} else {
+		// The reference time was predicted.
+		frac = ref_frac_next;
+	}
+	ref_frac = frac;
+	drift_measured_old = drift_measured;
+	// Whole ticks of the next reference time go into period_skew, the fraction is carried over.
+	next_q = (int32_t)ref_frac + drift_q;
+	period_skew = (int)(next_q >> 8);
+	ref_frac_next = (uint16_t)(next_q & 0xff);
+}
+
+static inline void drift_wait_sub_tick(void) {
+	// We woke up at the tick before the reference time: wait for its fraction on the DCO.
+	rtimer_clock_t t_stop = RTIMER_NOW_DCO() + (rtimer_clock_t)(((uint32_t)ref_frac_next * CLOCK_PHI) >> 8);
+	while (RTIMER_CLOCK_LT(RTIMER_NOW_DCO(), t_stop));
+}
+#endif /* CHAOS_DRIFT_TRACKING */
+
+static inline void bootstrap_done(void) {
+	//leds_off(LEDS_RED);
+	// Initialize Energest values.
+	energest_init();
+#if CHAOS_DEBUG
+	high_T_irq = 0;
+	bad_crc = 0;
+#if CHAOS_FEC
+	fec_rescued = 0;
+#endif /* CHAOS_FEC */
+#if CHAOS_FLAGS_CRC
+	flags_rescued = 0;
+#endif /* CHAOS_FLAGS_CRC */
+	bad_length = 0;
+	bad_header = 0;
+#endif /* CHAOS_DEBUG */
+}
+
+#if CHAOS_ADAPTIVE_GUARD
+static inline void guard_measure(void) {
+	int err = (int)(get_t_ref_l() - t_ref_predicted);
+	int16_t dev;
+	guard_armed = 0;
+	if (err > (int)CHAOS_GUARD_TIME || err < -(int)CHAOS_GUARD_TIME) {
+		// Not a wake-up error: the node lost track of the reference time.
+		return;
+	}
+	err <<= 4;
+#if CHAOS_DRIFT_TRACKING
+	// Sub-tick position of the reference time against the predicted one.
+	err += ((int)(((uint32_t)(get_T_offset_h() + 1) << 8) / CLOCK_PHI) - (int)ref_frac_next) >> 4;
+#endif /* CHAOS_DRIFT_TRACKING */
+	if (guard_n < CHAOS_GUARD_SETTLE) {
+		guard_n++;
+	}
+	guard_err += (err - guard_err) / (int)guard_n;
+	dev = err - guard_err;
+	dev = dev < 0 ? -dev : dev;
+	guard_dev += (dev - (int16_t)guard_dev) / (int)guard_n;
+}
+
+static inline void guard_update(void) {
+	rtimer_clock_t g = CHAOS_GUARD_TIME;
+	uint16_t bound;
+	if (guard_n == CHAOS_GUARD_SETTLE
+#if CHAOS_DRIFT_TRACKING
+			// The drift tracker starts over after temperature changes: so does the guard.
+			&& drift_n == CHAOS_DRIFT_WINDOW
+#endif /* CHAOS_DRIFT_TRACKING */
+			) {
+		// Only rounds starting before we wake up are missed: bound the early side of the error.
+		bound = CHAOS_GUARD_DEVS * guard_dev + (guard_err < 0 ? -guard_err : 0);
+		g = CHAOS_GUARD_MIN + ((bound + 15) >> 4);
+		if (g > CHAOS_GUARD_TIME) {
+			g = CHAOS_GUARD_TIME;
+		}
+	}
+	// Widen the guard after every phase without reference time.
+	guard = g * (1 + sync_missed);
+}
+#endif /* CHAOS_ADAPTIVE_GUARD */
+
 static inline void estimate_period_skew(void) {
 	// Estimate clock skew over a period only if the reference time has been updated.
 	if (CHAOS_IS_SYNCED()) {
+#if CHAOS_DRIFT_TRACKING
+		// Track the drift over many periods.
+		track_drift();
+#else
 		// Estimate clock skew based on previous reference time and the Chaos period.
 		period_skew = get_t_ref_l() - (t_ref_l_old + (rtimer_clock_t)CHAOS_PERIOD);
+#endif /* CHAOS_DRIFT_TRACKING */
 		// Update old reference time with the newer one.
 		t_ref_l_old = get_t_ref_l();
 		// If Chaos is still bootstrapping, count the number of consecutive updates of the reference time.
@@ -239,20 +512,114 @@ static inline void estimate_period_skew(void) {
 			// Check if Chaos has exited from bootstrapping.
 			if (!CHAOS_IS_BOOTSTRAPPING()) {
 				// Chaos has exited from bootstrapping.
-				//leds_off(LEDS_RED);
-				// Initialize Energest values.
-				energest_init();
-#if CHAOS_DEBUG
-				high_T_irq = 0;
-				bad_crc = 0;
-				bad_length = 0;
-				bad_header = 0;
-#endif /* CHAOS_DEBUG */
-
+				bootstrap_done();
 			}
 		}
 	}
+#if CHAOS_DRIFT_TRACKING
+	else {
+		// The next measurement has no reference time to compare with.
+		drift_measured_old = 0;
+	}
+#endif /* CHAOS_DRIFT_TRACKING */
+}
+
+#if CHAOS_GLOBAL_TIME
+static inline void global_time_update(void) {
+	// The reference time belongs to the round we expected, received or not.
+#if CHAOS_DRIFT_TRACKING
+	chaos_time_update(CHAOS_NEXT_SEQ_NO() - 1, drift_q);
+#else
+	chaos_time_update(CHAOS_NEXT_SEQ_NO() - 1, (int32_t)period_skew << 8);
+#endif /* CHAOS_DRIFT_TRACKING */
+}
+#endif /* CHAOS_GLOBAL_TIME */
+
+#if CHAOS_FAST_JOIN
+// Listen only after every CHAOS_JOIN_SERVE_EVERY-th round.
+#define JOIN_SERVE_DUE() (CHAOS_DATA->seq_no % CHAOS_JOIN_SERVE_EVERY == 0)
+
+static inline void join_serve(rtimer_clock_t t_stop) {
+	chaos_join_info info;
+	// Our last round and what we know of the schedule.
+	info.seq_no = CHAOS_DATA->seq_no;
+	info.period = CHAOS_PERIOD;
+	info.skew = period_skew;
+	chaos_join_serve(t_stop, &info);
+}
+
+static inline uint8_t join_schedule(void) {
+	chaos_join_info info;
+	if (!chaos_join_end(&info) || info.period != CHAOS_PERIOD) {
+		return 0;
+	}
+	// The last round of the neighbor is ours, its skew our first estimate.
+	CHAOS_DATA->seq_no = info.seq_no;
+	period_skew = info.skew;
+#if CHAOS_DRIFT_TRACKING
+	drift_q = (int32_t)info.skew << 8;
+#endif /* CHAOS_DRIFT_TRACKING */
+	t_ref_l_old = CHAOS_REFERENCE_TIME;
+	skew_estimated = CHAOS_BOOTSTRAP_PERIODS;
+	bootstrap_done();
+#if CHAOS_GLOBAL_TIME
+	global_time_update();
+#endif /* CHAOS_GLOBAL_TIME */
+	return 1;
 }
+#endif /* CHAOS_FAST_JOIN */
+
+/** @} */
+
+/**
+ * \defgroup chaos-test-power Transmit power control
+ * @{
+ */
+
+#if CHAOS_POWER_CONTROL
+static inline void init_tx_power(void) {
+	// Start from the highest level not above CC2420_TXPOWER.
+	while (power_idx > 0 && power_levels[power_idx] > CC2420_TXPOWER) {
+		power_idx--;
+	}
+	chaos_set_tx_power(power_levels[power_idx]);
+}
+
+static inline void adapt_tx_power(void) {
+	uint8_t idx = power_idx;
+	if (!get_rx_cnt() || get_complete() != CHAOS_COMPLETE) {
+		// The round did not complete: step up right away.
+		if (idx < POWER_LEVELS - 1) {
+			idx++;
+		}
+		power_hold = 0;
+	} else if (CHAOS_IS_SYNCED() &&
+			(rtimer_clock_t)(get_t_complete_l() - get_t_ref_l()) > CHAOS_POWER_TARGET_LATENCY) {
+		// Completed, but too late: step up.
+		if (idx < POWER_LEVELS - 1) {
+			idx++;
+		}
+		power_hold = 0;
+	} else if (get_crc_err_cnt() > get_rx_cnt()) {
+		// Completed in time, but mostly corrupted receptions: less power means less interference.
+		if (idx > 0) {
+			idx--;
+		}
+		power_hold = 0;
+	} else if (++power_hold >= CHAOS_POWER_HOLD) {
+		// Completed in time for a while: try the next lower level.
+		if (idx > 0) {
+			idx--;
+		}
+		power_hold = 0;
+	}
+	if (idx != power_idx) {
+		// Chaos applies it at the start of the next phase.
+		power_idx = idx;
+		chaos_set_tx_power(power_levels[power_idx]);
+	}
+}
+#endif /* CHAOS_POWER_CONTROL */
 
 /** @} */
 
@@ -264,10 +631,12 @@ static inline void estimate_period_skew(void) {
 
 uint16_t node_index;
 
-static inline void setArrayIndex(void){
+static inline void setArrayIndexIn(chaos_data_struct *d){
 	//set all flags to zero and the the one for this node to one
 	//all flags to zero
-	memset(&chaos_data.flags[0], 0, MERGE_LEN * sizeof(uint8_t));
+	memset(&d->flags[0], 0, MERGE_LEN * sizeof(uint8_t));
+	//no payload contributed so far
+	memset(&d->chunks[0], 0, CHAOS_CHUNK_MAP_LEN);
 	//find my index
 	unsigned int arrayIndex = node_index / 8;
 	if( arrayIndex >= MERGE_LEN ){
@@ -277,61 +646,432 @@ static inline void setArrayIndex(void){
 	//find my offset
 	unsigned int arrayOffset = node_index % 8;
 	//set to one at index and offset
-  chaos_data.flags[arrayIndex] = 1 << arrayOffset;
+  d->flags[arrayIndex] = 1 << arrayOffset;
   return;
 }
 
-static inline void setData(){
-	//memset(&chaos_data.payload[0], 0, PAYLOAD_LEN * sizeof(uint8_t));
+static inline void setArrayIndex(void){
+	setArrayIndexIn(CHAOS_DATA);
+}
+
+#if CHAOS_MERGE_OP == CHAOS_MERGE_TOPK || CHAOS_MERGE_OP == CHAOS_MERGE_HIST || CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+static inline uint16_t dummyValue(unsigned long seq_no){
+	//dummy sensor reading, different at each node and round
+	return (uint16_t)(node_id * 37 + seq_no) % 1000;
+}
+#endif
+
+#if CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+static uint8_t nc_object[CHAOS_NC_OBJECT_LEN]; /**< \brief Object disseminated by the initiator. */
+
+static inline uint8_t nc_byte(unsigned long seq_no, uint16_t j) {
+	//dummy object, different at each round
+	return (uint8_t)(seq_no * 7 + j);
+}
+
+static void nc_deliver(unsigned long seq_no, const uint8_t *object) {
+	uint16_t j, bad = 0;
+	for (j = 0; j < CHAOS_NC_OBJECT_LEN; j++) {
+		bad += (object[j] != nc_byte(seq_no, j));
+	}
+	printf("nc object %lu %s\n", seq_no, bad ? "corrupted" : "ok");
+}
+#endif /* CHAOS_MERGE_OP */
+
+static inline void setDataIn(chaos_data_struct *d){
+	//memset(&d->payload[0], 0, PAYLOAD_LEN * sizeof(uint8_t));
 	uint8_t i;
+#if CHAOS_MERGE_OP == CHAOS_MERGE_TOPK
+	//our value first, all other entries unused
+	chaos_topk_entry *list = (chaos_topk_entry *)d->payload;
+	for( i=0; i < CHAOS_TOPK_K; i++ ){
+		list[i].value = 0;
+		list[i].node = CHAOS_TOPK_NONE;
+	}
+	list[0].value = dummyValue(d->seq_no);
+	list[0].node = CHAOS_GLOBAL_INDEX();
+	//the list starts at chunk zero
+	d->chunks[0] |= 1;
+	return;
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_HIST
+	//our bit in the bucket of our value
+	uint16_t byte = (dummyValue(d->seq_no) % CHAOS_HIST_BUCKETS) * MERGE_LEN + node_index / 8;
+	memset(&d->payload[0], 0, CHAOS_HIST_BUCKETS * MERGE_LEN);
+	d->payload[byte] = 1 << (node_index % 8);
+	d->chunks[(byte / CHAOS_CHUNK_LEN) / 8] |= 1 << ((byte / CHAOS_CHUNK_LEN) % 8);
+	return;
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+	//the whole object, coded block by block
+	uint16_t j;
+	for( j=0; j < CHAOS_NC_OBJECT_LEN; j++ ){
+		nc_object[j] = nc_byte(d->seq_no, j);
+	}
+	chaos_nc_prepare(nc_object);
+	return;
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+	//per section of CHAOS_MUX_SECTIONS: our presence (bitmaps that must be full),
+	//our vote (other bitmaps) or our temperature (maximum)
+	const chaos_mux_section *sec;
+	for( sec = chaos_mux_sections; sec < chaos_mux_sections + chaos_mux_sections_n; sec++ ){
+		if( !CHAOS_MUX_SECTION_OK(sec) ){
+			continue;
+		}
+		memset(&d->payload[sec->offset], 0, sec->len);
+		if( sec->op == CHAOS_MERGE_OR && sec->len >= MERGE_LEN &&
+				(sec->done == CHAOS_MUX_DONE_FULL || dummyValue(d->seq_no) % 3) ){
+			d->payload[sec->offset + node_index / 8] = 1 << (node_index % 8);
+		} else if( sec->op == CHAOS_MERGE_MAX ){
+			d->payload[sec->offset] = (uint8_t)(20 + dummyValue(d->seq_no) % 16);
+		}
+	}
+	return;
+#endif /* CHAOS_MERGE_OP */
 //	for( i=0; i < PAYLOAD_LEN/2; i++ ){
-//		chaos_data.payload[i] = (uint8_t) ((seqNo + node_id) * i);
+//		d->payload[i] = (uint8_t) ((seqNo + node_id) * i);
 //	}
 	//set dummy payload
 	for( i=0; i < PAYLOAD_LEN; i++ ){
-		chaos_data.payload[i] = (uint8_t) (0x11 * i);
+		d->payload[i] = (uint8_t) (0x11 * i);
+	}
+	//mark all chunks as written
+	for( i=0; i < CHAOS_CHUNKS; i++ ){
+		d->chunks[i / 8] |= 1 << (i % 8);
 	}
 	return;
 }
 
+static inline void setData(void){
+	setDataIn(CHAOS_DATA);
+}
+
+#if CHAOS_EARLY_STOP
+static void chaos_turned_off(void) {
+	if (phase_end_armed) {
+		phase_end_armed = 0;
+		// Chaos is done for this round: end the phase right away.
+		rtimer_advance(&rt, RTIMER_NOW() + 2);
+	}
+}
+
+static inline void arm_phase_end(void) {
+	phase_end_armed = 1;
+	if (get_state() == CHAOS_STATE_OFF) {
+		// Chaos already turned itself off.
+		chaos_turned_off();
+	}
+}
+#endif /* CHAOS_EARLY_STOP */
+
+#if CHAOS_AGREE
+static void agree_result(uint16_t proposal, uint8_t outcome) {
+	printf("agree %u %s\n", proposal, (outcome == CHAOS_AGREE_COMMIT) ? "commit" : "abort");
+}
+#endif /* CHAOS_AGREE */
+
+#if CHAOS_ABCAST
+static void abcast_deliver(unsigned long seq_no, uint16_t node, const uint8_t *msg) {
+	if (msg) {
+		printf("abcast %lu %u %u\n", seq_no, node, msg[0]);
+	} else {
+		printf("abcast %lu lost\n", seq_no);
+	}
+}
+
+static inline void send_abcast(void) {
+	// Queue one message per round carrying a counter, unless the queue is full.
+	static uint8_t msg[CHAOS_ABCAST_MSG_LEN];
+	if (chaos_abcast_send(msg)) {
+		msg[0]++;
+	}
+}
+#endif /* CHAOS_ABCAST */
+
+#if CHAOS_BURST > 1
+static void burst_next_round(uint8_t round, uint8_t *data) {
+	// Called from the SFD interrupt: keep it short.
+	if (get_complete() == CHAOS_COMPLETE) {
+		burst_completed++;
+	}
+	// Contribute to the next logical round, in the flooding data Chaos hands us.
+	chaos_data_struct *d = (chaos_data_struct *)data;
+	setArrayIndexIn(d);
+#if CHAOS_MERGE_OP == CHAOS_MERGE_TOPK || CHAOS_MERGE_OP == CHAOS_MERGE_HIST || CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+	if (node_index < CHAOS_NODES) {
+		setDataIn(d);
+	}
+#else
+	if (IS_INITIATOR()) {
+		setDataIn(d);
+	}
+#endif /* CHAOS_MERGE_OP */
+}
+#endif /* CHAOS_BURST */
+
+#if CHAOS_CLUSTERED
+#if CHAOS_MULTI_INITIATOR || CHAOS_MEMBERSHIP || CHAOS_SCHED || CHAOS_AGREE || CHAOS_ABCAST || \
+	CHAOS_HOPPING || CHAOS_BURST > 1
+#error "CHAOS_CLUSTERED runs plain data rounds, with fixed heads on fixed channels"
+#endif
+
+static const uint8_t cluster_channels[] = CHAOS_CLUSTER_CHANNELS;
+// every cluster on a channel of its own: frames of neighboring clusters would be merged otherwise
+typedef char cluster_channels_check[(sizeof(cluster_channels) >= CHAOS_NODES) ? 1 : -1];
+#define CLUSTER_CHANNEL()     cluster_channels[cluster_id]
+#define CLUSTER_LEAD_DUE()    (IS_CLUSTER_HEAD() && (IS_INITIATOR() || !CHAOS_IS_BOOTSTRAPPING()))
+#define CLUSTER_LEAD          (cluster_lead ? CHAOS_CLUSTER_LEAD : 0)
+#define PHASE_DURATION        (IS_CLUSTER_HEAD() ? CHAOS_DURATION : CHAOS_CLUSTER_DURATION)
+
+char chaos_scheduler(struct rtimer *t, void *ptr);
+
+static inline void backbone_prepare(void) {
+	// one flag per cluster, the aggregate of the cluster as payload
+	memset(&CHAOS_DATA->flags[0], 0, MERGE_LEN * sizeof(uint8_t));
+	CHAOS_DATA->flags[cluster_id / 8] = 1 << (cluster_id % 8);
+	memcpy(&CHAOS_DATA->chunks[0], cluster_chunks, CHAOS_CHUNK_MAP_LEN);
+}
+
+/*
+ * Local round of a cluster head, CHAOS_CLUSTER_LEAD before the backbone round:
+ * returns once it is time to start listening for the backbone with the given guard time.
+ */
+static PT_THREAD(cluster_round(struct pt *cpt, struct rtimer *t, void *ptr, rtimer_clock_t guard)) {
+	static rtimer_clock_t t_local, t_ref;
+	static unsigned long seq_no;
+	PT_BEGIN(cpt);
+
+	t_local = RTIMER_TIME(t);
+	// The local round must not move the reference time or the sequence number of the backbone.
+	t_ref = get_t_ref_l();
+	seq_no = CHAOS_DATA->seq_no;
+	CHAOS_DATA->seq_no = CHAOS_NEXT_SEQ_NO();
+	setArrayIndex();
+	setData();
+	chaos_set_channel(CLUSTER_CHANNEL());
+	chaos_start(CHAOS_INITIATOR, N_TX);
+	rtimer_set(t, t_local + CHAOS_CLUSTER_DURATION, 1, (rtimer_callback_t)chaos_scheduler, ptr);
+#if CHAOS_EARLY_STOP
+	// End the phase earlier if Chaos turns itself off.
+	arm_phase_end();
+#endif /* CHAOS_EARLY_STOP */
+	PT_YIELD(cpt);
+#if CHAOS_EARLY_STOP
+	phase_end_armed = 0;
+#endif /* CHAOS_EARLY_STOP */
+	chaos_stop();
+	cluster_complete = (get_complete() == CHAOS_COMPLETE);
+	// Keep the merged chunks for the backbone round, the payload stays in place.
+	memcpy(cluster_chunks, &CHAOS_DATA->chunks[0], CHAOS_CHUNK_MAP_LEN);
+	CHAOS_DATA->seq_no = seq_no;
+	set_t_ref_l(t_ref);
+	chaos_set_channel(RF_CHANNEL);
+	// Wake up for the backbone round.
+	if (guard > CHAOS_CLUSTER_LEAD - CHAOS_CLUSTER_DURATION) {
+		guard = CHAOS_CLUSTER_LEAD - CHAOS_CLUSTER_DURATION;
+	}
+	rtimer_set(t, t_local + CHAOS_CLUSTER_LEAD - guard, 1, (rtimer_callback_t)chaos_scheduler, ptr);
+	PT_YIELD(cpt);
+
+	PT_END(cpt);
+}
+#else
+#define CLUSTER_LEAD          0
+#endif /* CHAOS_CLUSTERED */
+
+#if CHAOS_SCHED
+static uint8_t sched_apps = 0;             /**< \brief Applications of the current round. */
+static rtimer_clock_t sched_duration = CHAOS_DURATION; /**< \brief Length of the current Chaos phase. */
+#define PHASE_DURATION sched_duration
+
+static void status_done(void) {
+	printf("sched status %lu complete %u\n", CHAOS_DATA->seq_no, get_complete() == CHAOS_COMPLETE);
+}
+
+static void aggregation_prepare(uint8_t initiator_) {
+#if CHAOS_MERGE_OP == CHAOS_MERGE_TOPK || CHAOS_MERGE_OP == CHAOS_MERGE_HIST || CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+	//all nodes with an index contribute a value
+	if (node_index < CHAOS_NODES) {
+		setData();
+	}
+#else
+	if (initiator_) {
+		setData();
+	}
+#endif /* CHAOS_MERGE_OP */
+}
+
+static void aggregation_done(void) {
+	printf("sched aggregation %lu, missed %u\n", CHAOS_DATA->seq_no, chaos_sched_get_missed());
+}
+
+/** \brief Flags only, every period. */
+static const chaos_sched_app status_app = {1, CHAOS_DURATION, CHAOS_MERGE_NONE, NULL, status_done};
+/** \brief Payload, every CHAOS_SCHED_AGG_PERIOD periods. */
+static const chaos_sched_app aggregation_app = {CHAOS_SCHED_AGG_PERIOD, CHAOS_DURATION, CHAOS_MERGE_OP,
+		aggregation_prepare, aggregation_done};
+#elif !CHAOS_CLUSTERED
+#define PHASE_DURATION CHAOS_DURATION
+#endif /* CHAOS_SCHED */
+
+#if CHAOS_MULTI_INITIATOR
+static inline void failover_wait_sub_tick(void) {
+	// We woke up at a low-frequency tick: wait for the rest of CHAOS_FAILOVER_HOPS slots
+	// (and for the fraction of the reference time) on the DCO.
+	rtimer_clock_t t_stop = RTIMER_NOW_DCO() + failover_wait_dco;
+#if CHAOS_DRIFT_TRACKING
+	t_stop += (rtimer_clock_t)(((uint32_t)ref_frac_next * CLOCK_PHI) >> 8);
+#endif /* CHAOS_DRIFT_TRACKING */
+	while (RTIMER_CLOCK_LT(RTIMER_NOW_DCO(), t_stop));
+}
+
+static inline uint8_t failover_initiate(void) {
+	if (get_rx_cnt() || get_state() != CHAOS_STATE_WAITING) {
+		// Somebody else already started the round.
+		return 0;
+	}
+	// Use the sequence number the other nodes expect.
+	CHAOS_DATA->seq_no = CHAOS_NEXT_SEQ_NO();
+#if CHAOS_SCHED
+	// Run the round the other nodes expect.
+	chaos_sched_prepare(sched_apps, 1);
+#else
+	//set data
+	setData();
+#endif /* CHAOS_SCHED */
+#if CHAOS_AGREE
+	if (IS_INITIATOR()) {
+		// Propose the sequence number, unless the last proposal is still pending.
+		chaos_agree_start((uint16_t)CHAOS_DATA->seq_no);
+	}
+	chaos_agree_prepare(1);
+#endif /* CHAOS_AGREE */
+#if CHAOS_ABCAST
+	// Our round after all: the expected sequence number is the one we use.
+	chaos_abcast_prepare(CHAOS_DATA->seq_no, 1);
+#endif /* CHAOS_ABCAST */
+	// Receivers start CHAOS_FAILOVER_HOPS slots late: keep the reference time where it was.
+	failover_wait_sub_tick();
+	return chaos_initiate(failover_wait_dco || failover_wait ? CHAOS_FAILOVER_HOPS : 0);
+}
+#endif /* CHAOS_MULTI_INITIATOR */
+
+#if CHAOS_SYNC_MODE
 char chaos_scheduler(struct rtimer *t, void *ptr) {
 	PT_BEGIN(&pt);
 
-	if (IS_INITIATOR()) {	// Chaos initiator.
+	if (IS_INITIATOR() && !CHAOS_MULTI_INITIATOR) {	// Chaos initiator.
 		while (1) {
+#if CHAOS_CLUSTERED
+			if (cluster_lead) {
+				// Local round of our cluster first.
+				PT_SPAWN(&pt, &cluster_pt, cluster_round(&cluster_pt, t, ptr, 0));
+			}
+#endif /* CHAOS_CLUSTERED */
 			// Increment sequence number.
-			chaos_data.seq_no++;
+			CHAOS_DATA->seq_no++;
 			//set my flag to one
 			setArrayIndex();
+#if CHAOS_SCHED
+			// Pick the applications of this round and let them set their data.
+			sched_apps = chaos_sched_next(CHAOS_DATA->seq_no, &sched_duration);
+			chaos_sched_prepare(sched_apps, 1);
+#elif CHAOS_CLUSTERED
+			// Contribute the aggregate of our cluster to the backbone.
+			backbone_prepare();
+#else
 			//set data
 			setData();
+#endif /* CHAOS_SCHED */
+#if CHAOS_MEMBERSHIP
+			// Flood the members and the last grant.
+			chaos_member_prepare(1);
+#endif /* CHAOS_MEMBERSHIP */
+#if CHAOS_AGREE
+			// Propose the sequence number, unless the last proposal is still pending.
+			chaos_agree_start((uint16_t)CHAOS_DATA->seq_no);
+			chaos_agree_prepare(1);
+#endif /* CHAOS_AGREE */
+#if CHAOS_ABCAST
+			// Fill the message slots.
+			send_abcast();
+			chaos_abcast_prepare(CHAOS_DATA->seq_no, 1);
+#endif /* CHAOS_ABCAST */
 			// Chaos phase.
 			//leds_on(LEDS_GREEN);
+			// Select the channels of this round.
+			chaos_set_hop_seq_no(CHAOS_DATA->seq_no);
 			// Start Chaos.
-			chaos_start((uint8_t *)&chaos_data, /*DATA_LEN,*/ CHAOS_INITIATOR, /*CHAOS_SYNC,*/ N_TX);
+			chaos_start(CHAOS_INITIATOR, /*CHAOS_SYNC,*/ N_TX);
 			// Store time at which Chaos has started.
 			t_start = RTIMER_TIME(t);
 			// Schedule end of Chaos phase based on CHAOS_DURATION.
-			rtimer_set(t, CHAOS_REFERENCE_TIME + CHAOS_DURATION, 1, (rtimer_callback_t)chaos_scheduler, ptr);
+			rtimer_set(t, CHAOS_REFERENCE_TIME + PHASE_DURATION, 1, (rtimer_callback_t)chaos_scheduler, ptr);
+#if CHAOS_EARLY_STOP
+			// End the phase earlier if Chaos turns itself off.
+			arm_phase_end();
+#endif /* CHAOS_EARLY_STOP */
 			// Yield the protothread.
 			PT_YIELD(&pt);
+#if CHAOS_EARLY_STOP
+			phase_end_armed = 0;
+#endif /* CHAOS_EARLY_STOP */
 
 			// Off phase.
 			//leds_off(LEDS_GREEN);
 			// Stop Chaos.
 			chaos_stop();
+#if CHAOS_AGREE
+			// Decide on the proposal.
+			chaos_agree_round_end();
+#endif /* CHAOS_AGREE */
+#if CHAOS_ABCAST
+			// Deliver the messages of completed rounds.
+			chaos_abcast_round_end();
+#endif /* CHAOS_ABCAST */
+#if CHAOS_MEMBERSHIP
+			// Grant indexes to joining nodes, reclaim the ones of dead and leaving nodes.
+			chaos_member_round_end(1);
+#endif /* CHAOS_MEMBERSHIP */
+#if CHAOS_SCHED
+			// Hand the merged data to the applications of the round.
+			chaos_sched_round_end();
+#endif /* CHAOS_SCHED */
+#if CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+			// Decode the object.
+			chaos_nc_round_end();
+#endif /* CHAOS_MERGE_OP */
 			if (!CHAOS_IS_BOOTSTRAPPING()) {
 				// Chaos has already successfully bootstrapped.
+#if CHAOS_POWER_CONTROL
+				// Adapt the transmit power to the outcome of the round.
+				adapt_tx_power();
+#endif /* CHAOS_POWER_CONTROL */
 				if (!CHAOS_IS_SYNCED()) {
 					// The reference time was not updated: increment reference time by CHAOS_PERIOD.
 					set_t_ref_l(CHAOS_REFERENCE_TIME + CHAOS_PERIOD);
 					set_t_ref_l_updated(1);
 				}
 			}
+#if CHAOS_CLUSTERED
+			cluster_lead = CLUSTER_LEAD_DUE();
+#endif /* CHAOS_CLUSTERED */
+#if CHAOS_FAST_JOIN
+			// Hand the schedule to rebooted neighbors, from chaos_join_process.
+			if (JOIN_SERVE_DUE()) {
+				rtimer_set(t, RTIMER_NOW() + CHAOS_JOIN_LISTEN, 1, (rtimer_callback_t)chaos_scheduler, ptr);
+				join_serve(RTIMER_TIME(t));
+				PT_YIELD(&pt);
+				chaos_join_end(NULL);
+			}
+#endif /* CHAOS_FAST_JOIN */
 			// Schedule begin of next Chaos phase based on CHAOS_PERIOD.
-			rtimer_set_long(t, CHAOS_REFERENCE_TIME, CHAOS_PERIOD, (rtimer_callback_t)chaos_scheduler, ptr);
+			rtimer_set_long(t, CHAOS_REFERENCE_TIME, CHAOS_PERIOD - CLUSTER_LEAD, (rtimer_callback_t)chaos_scheduler, ptr);
 			// Estimate the clock skew over the last period.
 			estimate_period_skew();
+#if CHAOS_GLOBAL_TIME
+			if (!CHAOS_IS_BOOTSTRAPPING()) {
+				global_time_update();
+			}
+#endif /* CHAOS_GLOBAL_TIME */
 			// Poll the process that prints statistics (will be activated later by Contiki).
 			process_poll(&chaos_print_stats_process);
 			// Yield the protothread.
@@ -339,38 +1079,211 @@ char chaos_scheduler(struct rtimer *t, void *ptr) {
 		}
 	} else {	// Chaos receiver.
 		while (1) {
+#if CHAOS_FAST_JOIN
+			if (skew_estimated == 0 && join_phases < CHAOS_JOIN_PHASES) {
+				// Nothing known of the schedule: ask the neighbors for it, from chaos_join_process
+				// (leave it 1 ms to turn the radio off).
+				join_phases++;
+				rtimer_set(t, RTIMER_TIME(t) + CHAOS_INIT_PERIOD - RTIMER_SECOND / 1000, 1,
+						(rtimer_callback_t)chaos_scheduler, ptr);
+				chaos_join(RTIMER_TIME(t));
+				PT_YIELD(&pt);
+				if (join_schedule()) {
+#if CHAOS_CLUSTERED
+					cluster_lead = CLUSTER_LEAD_DUE();
+#endif /* CHAOS_CLUSTERED */
+					// Schedule begin of next Chaos phase based on the reference time of the neighbor.
+					rtimer_set_long(t, CHAOS_REFERENCE_TIME, CHAOS_PERIOD + period_skew -
+							(CLUSTER_LEAD ? CLUSTER_LEAD : GUARD_TIME()),
+							(rtimer_callback_t)chaos_scheduler, ptr);
+				} else {
+					// Ask again at the end of the phase.
+					rtimer_set(t, RTIMER_TIME(t) + RTIMER_SECOND / 1000, 1,
+							(rtimer_callback_t)chaos_scheduler, ptr);
+				}
+				// Yield the protothread.
+				PT_YIELD(&pt);
+				continue;
+			}
+#endif /* CHAOS_FAST_JOIN */
+#if CHAOS_CLUSTERED
+			if (cluster_lead) {
+				// Local round of our cluster first.
+				PT_SPAWN(&pt, &cluster_pt, cluster_round(&cluster_pt, t, ptr, GUARD_TIME()));
+			}
+			// Heads listen to the backbone, members to the local round of their cluster.
+			chaos_set_channel(IS_CLUSTER_HEAD() ? RF_CHANNEL : CLUSTER_CHANNEL());
+#endif /* CHAOS_CLUSTERED */
 			// Chaos phase.
 			//leds_on(LEDS_GREEN);
 			setArrayIndex();
+#if CHAOS_SCHED
+			// Guess the applications of this round from the sequence number we expect.
+			sched_duration = CHAOS_DURATION;
+			sched_apps = CHAOS_IS_BOOTSTRAPPING() ? 0 : chaos_sched_next(CHAOS_NEXT_SEQ_NO(), &sched_duration);
+			chaos_sched_prepare(sched_apps, 0);
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_TOPK || CHAOS_MERGE_OP == CHAOS_MERGE_HIST || CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+			//all nodes with an index contribute a value
+			if (node_index < CHAOS_NODES && !IS_CLUSTER_HEAD()) {
+				setData();
+			}
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+			// Nothing known of the object of this round yet.
+			chaos_nc_prepare(NULL);
+#endif /* CHAOS_SCHED */
+#if CHAOS_CLUSTERED
+			if (IS_CLUSTER_HEAD()) {
+				// Contribute the aggregate of our cluster to the backbone.
+				backbone_prepare();
+			}
+#endif /* CHAOS_CLUSTERED */
+#if CHAOS_MEMBERSHIP
+			// Ask for an index, or give it back.
+			chaos_member_prepare(0);
+#endif /* CHAOS_MEMBERSHIP */
+#if CHAOS_AGREE
+			chaos_agree_prepare(0);
+#endif /* CHAOS_AGREE */
+#if CHAOS_ABCAST
+			// Fill the message slots for the round we expect.
+			send_abcast();
+			chaos_abcast_prepare(skew_estimated ? CHAOS_NEXT_SEQ_NO() : 0, 0);
+#endif /* CHAOS_ABCAST */
+			// Select the channels of this round: while the sequence number is unknown
+			// listen on the first hopping channel.
+			chaos_set_hop_seq_no(skew_estimated ? CHAOS_NEXT_SEQ_NO() : 0);
+#if CHAOS_DRIFT_TRACKING
+			if (!CHAOS_IS_BOOTSTRAPPING()) {
+				// Wake up at sub-tick precision.
+				drift_wait_sub_tick();
+			}
+#endif /* CHAOS_DRIFT_TRACKING */
 			// Start Chaos.
-			chaos_start((uint8_t *)&chaos_data, /*DATA_LEN,*/ CHAOS_RECEIVER, /*CHAOS_SYNC,*/ N_TX);
+			chaos_start(CHAOS_RECEIVER, /*CHAOS_SYNC,*/ N_TX);
 			if (CHAOS_IS_BOOTSTRAPPING()) {
 				// Chaos is still bootstrapping:
 				// Schedule end of Chaos phase based on CHAOS_INIT_DURATION.
 				rtimer_set(t, RTIMER_TIME(t) + CHAOS_INIT_DURATION, 1,
 					(rtimer_callback_t)chaos_scheduler, ptr);
 			} else {
-				// Chaos has already successfully bootstrapped:
-				// Schedule end of Chaos phase based on CHAOS_DURATION.
-				rtimer_set(t, RTIMER_TIME(t) + CHAOS_GUARD_TIME * (1 + sync_missed) + CHAOS_DURATION, 1,
-					(rtimer_callback_t)chaos_scheduler, ptr);
+#if CHAOS_MULTI_INITIATOR
+				initiated = 0;
+				if (IS_INITIATOR_CANDIDATE()) {
+					// Wake up again at the expected reference time, other candidates than the
+					// initiator once a flood of the initiator crossing CHAOS_FAILOVER_HOPS hops arrived.
+					failover_wait = IS_INITIATOR() ? 0 :
+							(rtimer_clock_t)((uint32_t)CHAOS_FAILOVER_HOPS * get_T_slot_h() / CLOCK_PHI);
+					failover_wait_dco = IS_INITIATOR() ? 0 :
+							(uint16_t)((uint32_t)CHAOS_FAILOVER_HOPS * get_T_slot_h() % CLOCK_PHI);
+					rtimer_set(t, RTIMER_TIME(t) + GUARD_TIME() + failover_wait, 1,
+						(rtimer_callback_t)chaos_scheduler, ptr);
+					PT_YIELD(&pt);
+					// Start the round if nobody else did so far.
+					initiated = failover_initiate();
+					// Schedule end of Chaos phase based on CHAOS_DURATION.
+					rtimer_set(t, RTIMER_TIME(t) + PHASE_DURATION - failover_wait, 1,
+						(rtimer_callback_t)chaos_scheduler, ptr);
+				} else
+#endif /* CHAOS_MULTI_INITIATOR */
+				{
+					// Chaos has already successfully bootstrapped:
+					// Schedule end of Chaos phase based on CHAOS_DURATION.
+					rtimer_set(t, RTIMER_TIME(t) + GUARD_TIME() + PHASE_DURATION, 1,
+						(rtimer_callback_t)chaos_scheduler, ptr);
+				}
 			}
+#if CHAOS_EARLY_STOP
+			// End the phase earlier if Chaos turns itself off.
+			arm_phase_end();
+#endif /* CHAOS_EARLY_STOP */
 			// Yield the protothread.
 			PT_YIELD(&pt);
+#if CHAOS_EARLY_STOP
+			phase_end_armed = 0;
+#endif /* CHAOS_EARLY_STOP */
 
 			// Off phase.
 			//leds_off(LEDS_GREEN);
 			// Stop Chaos.
 			chaos_stop();
+#if CHAOS_DRIFT_TRACKING
+			// Only reference times computed by Chaos measure the drift.
+			drift_measured = CHAOS_IS_SYNCED();
+#endif /* CHAOS_DRIFT_TRACKING */
+#if CHAOS_ADAPTIVE_GUARD
+			if (guard_armed && CHAOS_IS_SYNCED()
+#if CHAOS_MULTI_INITIATOR
+					// Our own round says nothing about our wake-up error.
+					&& !initiated
+#endif /* CHAOS_MULTI_INITIATOR */
+					) {
+				// Compare the reference time with the one we woke up for.
+				guard_measure();
+			}
+#endif /* CHAOS_ADAPTIVE_GUARD */
+#if CHAOS_AGREE
+			// Decide on the proposal.
+			chaos_agree_round_end();
+#endif /* CHAOS_AGREE */
+#if CHAOS_ABCAST
+			// Deliver the messages of completed rounds.
+			chaos_abcast_round_end();
+#endif /* CHAOS_ABCAST */
+#if CHAOS_MEMBERSHIP
+			// Take the granted index, or drop a reclaimed one.
+			chaos_member_round_end(0);
+#endif /* CHAOS_MEMBERSHIP */
+#if CHAOS_SCHED
+			// Hand the merged data to the applications of the round.
+			chaos_sched_round_end();
+#endif /* CHAOS_SCHED */
+#if CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+			// Decode the object.
+			chaos_nc_round_end();
+#endif /* CHAOS_MERGE_OP */
 			if (CHAOS_IS_BOOTSTRAPPING()) {
 				// Chaos is still bootstrapping.
 				if (!CHAOS_IS_SYNCED()) {
 					// The reference time was not updated: reset skew_estimated to zero.
 					skew_estimated = 0;
 				}
+#if CHAOS_MULTI_INITIATOR
+				if (get_rx_cnt()) {
+					boot_missed = 0;
+				} else if (IS_INITIATOR() && ++boot_missed >= CHAOS_FAILOVER_BOOT_PHASES) {
+					// Nobody is running rounds: start a fresh schedule with the end of this phase
+					// as reference time.
+					set_t_ref_l(RTIMER_TIME(t));
+					set_t_ref_l_updated(1);
+					t_ref_l_old = RTIMER_TIME(t) - (rtimer_clock_t)CHAOS_PERIOD;
+					skew_estimated = CHAOS_BOOTSTRAP_PERIODS;
+					failover_active = 1;
+					boot_missed = 0;
+				}
+#endif /* CHAOS_MULTI_INITIATOR */
 			} else {
 				// Chaos has already successfully bootstrapped.
+#if CHAOS_POWER_CONTROL
+				// Adapt the transmit power to the outcome of the round.
+				adapt_tx_power();
+#endif /* CHAOS_POWER_CONTROL */
+#if CHAOS_MULTI_INITIATOR
+				if (initiated) {
+					// We started the round: keep doing so until somebody else is faster.
+					failover_active = 1;
+					if (!CHAOS_IS_SYNCED()) {
+						// Our start was the reference time.
+						set_t_ref_l(CHAOS_REFERENCE_TIME + CHAOS_PERIOD + period_skew);
+						set_t_ref_l_updated(1);
+					}
+				} else if (CHAOS_IS_SYNCED()) {
+					// Another node started the round.
+					failover_active = 0;
+				}
+				if (!CHAOS_IS_SYNCED() && !initiated) {
+#else
 				if (!CHAOS_IS_SYNCED()) {
+#endif /* CHAOS_MULTI_INITIATOR */
 					// The reference time was not updated:
 					// increment reference time by CHAOS_PERIOD + period_skew.
 					set_t_ref_l(CHAOS_REFERENCE_TIME + CHAOS_PERIOD + period_skew);
@@ -386,6 +1299,14 @@ char chaos_scheduler(struct rtimer *t, void *ptr) {
 			}
 			// Estimate the clock skew over the last period.
 			estimate_period_skew();
+#if CHAOS_GLOBAL_TIME
+			if (!CHAOS_IS_BOOTSTRAPPING()) {
+				global_time_update();
+			}
+#endif /* CHAOS_GLOBAL_TIME */
+#if CHAOS_CLUSTERED
+			cluster_lead = CLUSTER_LEAD_DUE();
+#endif /* CHAOS_CLUSTERED */
 			if (CHAOS_IS_BOOTSTRAPPING()) {
 				// Chaos is still bootstrapping.
 				if (skew_estimated == 0) {
@@ -401,11 +1322,134 @@ char chaos_scheduler(struct rtimer *t, void *ptr) {
 				}
 			} else {
 				// Chaos has already successfully bootstrapped:
-				// Schedule begin of next Chaos phase based on reference time and CHAOS_PERIOD.
-				rtimer_set_long(t, CHAOS_REFERENCE_TIME, CHAOS_PERIOD +
-						period_skew - CHAOS_GUARD_TIME * (1 + sync_missed),
+				// Schedule begin of next Chaos phase based on reference time and CHAOS_PERIOD
+				// (cluster heads: of the local round, which applies the guard time itself).
+#if CHAOS_FAST_JOIN
+				if (sync_missed == 0) {
+					// Hand the schedule to rebooted neighbors, from chaos_join_process.
+					if (JOIN_SERVE_DUE()) {
+						rtimer_set(t, RTIMER_NOW() + CHAOS_JOIN_LISTEN, 1, (rtimer_callback_t)chaos_scheduler, ptr);
+						join_serve(RTIMER_TIME(t));
+						PT_YIELD(&pt);
+						chaos_join_end(NULL);
+					}
+				}
+#endif /* CHAOS_FAST_JOIN */
+#if CHAOS_ADAPTIVE_GUARD
+				guard_update();
+				t_ref_predicted = CHAOS_REFERENCE_TIME + (rtimer_clock_t)CHAOS_PERIOD + period_skew;
+				guard_armed = 1;
+#endif /* CHAOS_ADAPTIVE_GUARD */
+				rtimer_set_long(t, CHAOS_REFERENCE_TIME, CHAOS_PERIOD + period_skew -
+						(CLUSTER_LEAD ? CLUSTER_LEAD : GUARD_TIME()),
+						(rtimer_callback_t)chaos_scheduler, ptr);
+			}
+			// Yield the protothread.
+			PT_YIELD(&pt);
+		}
+	}
+
+	PT_END(&pt);
+}
+#else
+#if CHAOS_MULTI_INITIATOR || CHAOS_AGREE || CHAOS_ABCAST || CHAOS_MEMBERSHIP || CHAOS_SCHED || CHAOS_CLUSTERED || \
+		CHAOS_FAST_JOIN || CHAOS_GLOBAL_TIME
+#error "event-triggered rounds (CHAOS_NO_SYNC) carry plain Chaos data only"
+#endif
+/*
+ * Event-triggered rounds: receivers sleep and only check the channel every
+ * CHAOS_LPL_INTERVAL. On an event (simulated every CHAOS_PERIOD) the initiator
+ * first wakes them up, then floods right away.
+ */
+char chaos_scheduler(struct rtimer *t, void *ptr) {
+	PT_BEGIN(&pt);
+
+	if (IS_INITIATOR()) {	// Chaos initiator.
+		while (1) {
+			// Increment sequence number.
+			CHAOS_DATA->seq_no++;
+			//set my flag to one
+			setArrayIndex();
+			//set data
+			setData();
+			// Wake up the network: one frame every CHAOS_WAKEUP_GAP, covering one full listening interval.
+			t_start = RTIMER_NOW();
+			while (RTIMER_CLOCK_LT(RTIMER_NOW(), t_start + CHAOS_LPL_INTERVAL + CHAOS_LPL_LISTEN)) {
+				chaos_wakeup();
+				rtimer_set(t, RTIMER_NOW() + CHAOS_WAKEUP_GAP, 1, (rtimer_callback_t)chaos_scheduler, ptr);
+				PT_YIELD(&pt);
+			}
+			chaos_wakeup_end();
+			chaos_set_hop_seq_no(CHAOS_DATA->seq_no);
+			// Start Chaos.
+			chaos_start(CHAOS_INITIATOR, N_TX);
+			// Store time at which Chaos has started.
+			t_start = RTIMER_NOW();
+			// Schedule end of Chaos phase based on CHAOS_DURATION.
+			rtimer_set(t, t_start + CHAOS_DURATION, 1, (rtimer_callback_t)chaos_scheduler, ptr);
+#if CHAOS_EARLY_STOP
+			// End the phase earlier if Chaos turns itself off.
+			arm_phase_end();
+#endif /* CHAOS_EARLY_STOP */
+			// Yield the protothread.
+			PT_YIELD(&pt);
+#if CHAOS_EARLY_STOP
+			phase_end_armed = 0;
+#endif /* CHAOS_EARLY_STOP */
+			// Stop Chaos.
+			chaos_stop();
+#if CHAOS_POWER_CONTROL
+			// Adapt the transmit power to the outcome of the round.
+			adapt_tx_power();
+#endif /* CHAOS_POWER_CONTROL */
+			// Schedule the next event.
+			rtimer_set_long(t, t_start, CHAOS_PERIOD, (rtimer_callback_t)chaos_scheduler, ptr);
+			// Poll the process that prints statistics (will be activated later by Contiki).
+			process_poll(&chaos_print_stats_process);
+			// Yield the protothread.
+			PT_YIELD(&pt);
+		}
+	} else {	// Chaos receiver.
+		while (1) {
+			t_start = RTIMER_TIME(t);
+			if (chaos_lpl_check()) {
+				// Woken up: the round starts once the wake-up frames end.
+				setArrayIndex();
+#if CHAOS_MERGE_OP == CHAOS_MERGE_TOPK || CHAOS_MERGE_OP == CHAOS_MERGE_HIST || CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+				//all nodes with an index contribute a value
+				if (node_index < CHAOS_NODES) {
+					setData();
+				}
+#endif /* CHAOS_MERGE_OP */
+				// The sequence number is unknown: listen on the first hopping channel.
+				chaos_set_hop_seq_no(0);
+				// Start Chaos.
+				chaos_start(CHAOS_RECEIVER, N_TX);
+				// Schedule end of Chaos phase: the rest of the wake-up train plus CHAOS_DURATION.
+				rtimer_set(t, RTIMER_NOW() + CHAOS_LPL_INTERVAL + CHAOS_DURATION, 1,
 						(rtimer_callback_t)chaos_scheduler, ptr);
+#if CHAOS_EARLY_STOP
+				// End the phase earlier if Chaos turns itself off.
+				arm_phase_end();
+#endif /* CHAOS_EARLY_STOP */
+				// Yield the protothread.
+				PT_YIELD(&pt);
+#if CHAOS_EARLY_STOP
+				phase_end_armed = 0;
+#endif /* CHAOS_EARLY_STOP */
+				// Stop Chaos.
+				chaos_stop();
+#if CHAOS_POWER_CONTROL
+				// Adapt the transmit power to the outcome of the round.
+				adapt_tx_power();
+#endif /* CHAOS_POWER_CONTROL */
+				// Poll the process that prints statistics (will be activated later by Contiki).
+				process_poll(&chaos_print_stats_process);
+				// Resume listening one interval after the end of the round.
+				t_start = RTIMER_TIME(t);
 			}
+			// Schedule the next channel check.
+			rtimer_set(t, t_start + CHAOS_LPL_INTERVAL, 1, (rtimer_callback_t)chaos_scheduler, ptr);
 			// Yield the protothread.
 			PT_YIELD(&pt);
 		}
@@ -413,6 +1457,7 @@ char chaos_scheduler(struct rtimer *t, void *ptr) {
 
 	PT_END(&pt);
 }
+#endif /* CHAOS_SYNC_MODE */
 
 /** @} */
 
@@ -421,6 +1466,7 @@ char chaos_scheduler(struct rtimer *t, void *ptr) {
  * @{
  */
 
+#if !CHAOS_MEMBERSHIP
 static uint8_t init_mapping(uint16_t nodeID);
 
 #ifdef NODE_ID_MAPPING
@@ -428,11 +1474,17 @@ static uint8_t init_mapping(uint16_t nodeID);
 //mapping of node id to flag
 static const uint16_t mapping[] = NODE_ID_MAPPING;
 
+#if CHAOS_CLUSTERED
+#define MAPPING_LEN (CHAOS_NODES * CHAOS_NODES) // cluster by cluster
+#else
+#define MAPPING_LEN CHAOS_NODES
+#endif /* CHAOS_CLUSTERED */
+
 //execute mapping of node id to flag
 static uint8_t init_mapping(uint16_t nodeID){
 	unsigned int i;
 	//lookup id
-	for( i = 0; i < CHAOS_NODES; i++ ){
+	for( i = 0; i < MAPPING_LEN; i++ ){
 		if( nodeID == mapping[i] ){
 			node_index = i;
 			return 1;
@@ -452,11 +1504,13 @@ static uint8_t init_mapping(uint16_t nodeID){
 }
 
 #endif
+#endif /* CHAOS_MEMBERSHIP */
 
 PROCESS(chaos_test, "Chaos test");
 AUTOSTART_PROCESSES(&chaos_test);
 PROCESS_THREAD(chaos_test, ev, data)
 {
+	static uint8_t has_index;
 	PROCESS_BEGIN();
 #ifdef TESTBED
 #if (TESTBED == indriya) || (TESTBED == twist)
@@ -469,13 +1523,60 @@ PROCESS_THREAD(chaos_test, ev, data)
   //logging
 	printf("chaos test! tx power: %u, proc cycles: %u, timeouts: %u, max timeout: %u, min timeout: %u, tx on complete: %d, payload: %d, period %lu, duration %lu, node count: %u\n", CC2420_TXPOWER, (uint16_t)PROCESSING_CYCLES, TIMEOUT, MAX_SLOTS_TIMEOUT, MIN_SLOTS_TIMEOUT, N_TX_COMPLETE, PAYLOAD_LEN, CHAOS_PERIOD, CHAOS_DURATION, CHAOS_NODES);
 	//leds_on(LEDS_RED);
-	if (init_mapping(node_id)) {
+#if CHAOS_MEMBERSHIP
+	// The initiator allocates the indexes.
+	has_index = chaos_member_init(IS_INITIATOR());
+#else
+	has_index = init_mapping(node_id);
+#endif /* CHAOS_MEMBERSHIP */
+	if (has_index) {
+#if CHAOS_CLUSTERED
+		// Split the index: cluster, then index within the cluster.
+		cluster_id = node_index / CHAOS_NODES;
+		node_index %= CHAOS_NODES;
+		if (IS_INITIATOR() && !IS_CLUSTER_HEAD()) {
+			printf("Cluster ERROR: the initiator must be the head of its cluster\n");
+		}
+#endif /* CHAOS_CLUSTERED */
 		// Initialize Chaos data.
-		chaos_data.seq_no = 0;
+		CHAOS_DATA->seq_no = 0;
 		// Start print stats processes.
 		process_start(&chaos_print_stats_process, NULL);
 		// Start Chaos busy-waiting process.
 		process_start(&chaos_process, NULL);
+#if CHAOS_FAST_JOIN
+		// Start the process that sends and answers join requests.
+		process_start(&chaos_join_process, NULL);
+#endif /* CHAOS_FAST_JOIN */
+#if CHAOS_EARLY_STOP
+		// Get notified when Chaos is done with a round.
+		chaos_set_off_hook(chaos_turned_off);
+#endif /* CHAOS_EARLY_STOP */
+#if CHAOS_AGREE
+		// Every node votes yes and prints the outcome.
+		chaos_agree_init(NULL, agree_result);
+#endif /* CHAOS_AGREE */
+#if CHAOS_ABCAST
+		// Print every delivered message.
+		chaos_abcast_init(abcast_deliver);
+#endif /* CHAOS_ABCAST */
+#if CHAOS_BURST > 1
+		// Chain logical rounds within each Chaos phase.
+		chaos_set_burst_hook(burst_next_round);
+#endif /* CHAOS_BURST */
+#if CHAOS_SCHED
+		// Register the applications, in the same order on all nodes.
+		chaos_sched_register(&status_app);
+		chaos_sched_register(&aggregation_app);
+#endif /* CHAOS_SCHED */
+#if CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+		// Check and print every decoded object.
+		chaos_nc_init(nc_deliver);
+#endif /* CHAOS_MERGE_OP */
+#if CHAOS_POWER_CONTROL
+		// Start power control from the configured transmit power.
+		init_tx_power();
+#endif /* CHAOS_POWER_CONTROL */
 		// Start Chaos experiment in one second.
 		rtimer_set(&rt, RTIMER_NOW() + RTIMER_SECOND, 1, (rtimer_callback_t)chaos_scheduler, NULL);
 	}
@@ -70,6 +70,43 @@
 #define INITIATOR_NODE_ID       1
 #endif
 
+/**
+ * \brief Allow any synchronized node to start a round (initiator failover).
+ *        The initiator keeps starting rounds, receivers start them as well once they
+ *        missed \link CHAOS_FAILOVER_PERIODS \endlink consecutive rounds.
+ *        Default value: 0 (only the initiator starts rounds).
+ */
+#ifndef CHAOS_MULTI_INITIATOR
+#define CHAOS_MULTI_INITIATOR 0
+#endif
+
+/**
+ * \brief Consecutive phases without synchronization after which a receiver starts rounds itself.
+ *        With 0, every synchronized node starts every round.
+ *        Default value: 2.
+ */
+#ifndef CHAOS_FAILOVER_PERIODS
+#define CHAOS_FAILOVER_PERIODS 2
+#endif
+
+/**
+ * \brief Slots a receiver starting a round waits for beyond the expected reference time,
+ *        so that a flood of the initiator crossing that many hops arrives first.
+ *        Default value: 8.
+ */
+#ifndef CHAOS_FAILOVER_HOPS
+#define CHAOS_FAILOVER_HOPS 8
+#endif
+
+/**
+ * \brief Bootstrapping phases without any reception after which the initiator
+ *        starts a fresh schedule (only with \link CHAOS_MULTI_INITIATOR \endlink).
+ *        Default value: three periods worth of bootstrapping phases.
+ */
+#ifndef CHAOS_FAILOVER_BOOT_PHASES
+#define CHAOS_FAILOVER_BOOT_PHASES (3 * CHAOS_PERIOD / CHAOS_INIT_PERIOD)
+#endif
+
 /**
  * \brief Maximum number of transmissions N.
  *        Default value: 255.
@@ -85,6 +122,139 @@
 #define N_TX_COMPLETE 						5
 #endif
 
+/**
+ * \brief Adapt the transmit power at runtime, starting from \link CC2420_TXPOWER \endlink.
+ *        Default value: 0 (fixed transmit power).
+ */
+#ifndef CHAOS_POWER_CONTROL
+#define CHAOS_POWER_CONTROL 0
+#endif
+
+/**
+ * \brief Latency from the reference time to completion that power control aims to keep.
+ *        Default value: 100 ms.
+ */
+#ifndef CHAOS_POWER_TARGET_LATENCY
+#define CHAOS_POWER_TARGET_LATENCY (RTIMER_SECOND / 10)
+#endif
+
+/**
+ * \brief Consecutive rounds completed in time before power control tries the next lower level.
+ *        Default value: 8.
+ */
+#ifndef CHAOS_POWER_HOLD
+#define CHAOS_POWER_HOLD 8
+#endif
+
+/**
+ * \brief End the Chaos phase as soon as Chaos turns itself off, instead of
+ *        waiting for the end of \link CHAOS_DURATION \endlink.
+ *        Default value: 1.
+ */
+#ifndef CHAOS_EARLY_STOP
+#define CHAOS_EARLY_STOP 1
+#endif
+
+/**
+ * \brief Run a network-wide agreement on the sequence number at each round (see chaos-agree.h).
+ *        Default value: 0.
+ */
+#ifndef CHAOS_AGREE
+#define CHAOS_AGREE 0
+#endif
+
+/**
+ * \brief Run an ordered atomic broadcast, every node sending one message per round (see chaos-abcast.h).
+ *        Each node adds 2 * \link CHAOS_ABCAST_MSG_LEN \endlink bytes to the packet, taken from
+ *        the default \link PAYLOAD_LEN \endlink.
+ *        Default value: 0.
+ */
+#ifndef CHAOS_ABCAST
+#define CHAOS_ABCAST 0
+#endif
+
+/**
+ * \brief Length of atomic broadcast messages.
+ *        Default value: 4 bytes.
+ */
+#ifndef CHAOS_ABCAST_MSG_LEN
+#define CHAOS_ABCAST_MSG_LEN 4
+#endif
+
+/**
+ * \brief Allocate flag indexes at runtime instead of using the static node ID mapping
+ *        (see chaos-member.h). \link CHAOS_NODES \endlink is the maximum number of members.
+ *        Requires a fixed initiator.
+ *        Default value: 0.
+ */
+#ifndef CHAOS_MEMBERSHIP
+#define CHAOS_MEMBERSHIP 0
+#endif
+
+/**
+ * \brief Share the Chaos phases among several periodic applications (see chaos-sched.h):
+ *        the test runs a status round every period and an aggregation of the payload
+ *        every \link CHAOS_SCHED_AGG_PERIOD \endlink periods.
+ *        Default value: 0.
+ */
+#ifndef CHAOS_SCHED
+#define CHAOS_SCHED 0
+#endif
+
+/**
+ * \brief Keep a network-wide global time referenced to the initiator (see chaos-time.h),
+ *        updated after every round once bootstrapped.
+ *        Default value: 0.
+ */
+#ifndef CHAOS_GLOBAL_TIME
+#define CHAOS_GLOBAL_TIME 0
+#endif
+
+/**
+ * \brief Period of the aggregation application, in Chaos periods.
+ *        Default value: 15.
+ */
+#ifndef CHAOS_SCHED_AGG_PERIOD
+#define CHAOS_SCHED_AGG_PERIOD 15
+#endif
+
+/**
+ * \brief Two-level Chaos for large networks: \link CHAOS_NODES \endlink clusters of
+ *        \link CHAOS_NODES \endlink nodes each, the first node of a cluster being its head.
+ *        Every period the clusters run local rounds on their own channels, started by their
+ *        heads, then the heads run a backbone round with one flag per cluster and the cluster
+ *        aggregates as payload, started by the initiator (which must be a head).
+ *        Default value: 0.
+ */
+#ifndef CHAOS_CLUSTERED
+#define CHAOS_CLUSTERED 0
+#endif
+
+/**
+ * \brief Channels of the local rounds, cluster i using entry i: frames carry no cluster id,
+ *        so every cluster needs a channel of its own, at least \link CHAOS_NODES \endlink
+ *        distinct entries (at most 15 clusters). The backbone uses RF_CHANNEL.
+ */
+#ifndef CHAOS_CLUSTER_CHANNELS
+#define CHAOS_CLUSTER_CHANNELS {15, 20, 25, 11}
+#endif
+
+/**
+ * \brief Duration of the local rounds.
+ *        Default value: 250 ms.
+ */
+#ifndef CHAOS_CLUSTER_DURATION
+#define CHAOS_CLUSTER_DURATION (RTIMER_SECOND / 4)
+#endif
+
+/**
+ * \brief Time between the start of the local rounds and the one of the backbone round.
+ *        Default value: \link CHAOS_CLUSTER_DURATION \endlink plus four guard times.
+ */
+#ifndef CHAOS_CLUSTER_LEAD
+#define CHAOS_CLUSTER_LEAD (CHAOS_CLUSTER_DURATION + 4 * CHAOS_GUARD_TIME)
+#endif
+
 /**
  * \brief define number of nodes (if not testbed config is used)
  *        Default value: 3.
@@ -145,6 +315,66 @@
 #define CHAOS_GUARD_TIME       (RTIMER_SECOND / 1000)   // 1000 us
 #endif /* COOJA */
 
+/**
+ * \brief Derive the guard time of each receiver from its measured wake-up errors,
+ *        up to \link CHAOS_GUARD_TIME \endlink, instead of always using the latter.
+ *        Default value: 0 (disabled).
+ */
+#ifndef CHAOS_ADAPTIVE_GUARD
+#define CHAOS_ADAPTIVE_GUARD   0
+#endif
+
+/**
+ * \brief Margin added to the adaptive guard time for the wake-up of the radio.
+ *        Default value: 4 low-frequency ticks (122 us).
+ */
+#ifndef CHAOS_GUARD_MIN
+#define CHAOS_GUARD_MIN        (RTIMER_SECOND / 8192)   // 122 us
+#endif
+
+/**
+ * \brief Mean absolute deviations of the wake-up error covered by the adaptive guard time.
+ *        Default value: 4.
+ */
+#ifndef CHAOS_GUARD_DEVS
+#define CHAOS_GUARD_DEVS       4
+#endif
+
+/**
+ * \brief Wake-up errors measured before the adaptive guard time replaces \link CHAOS_GUARD_TIME \endlink,
+ *        and the window they are averaged over afterwards.
+ *        Default value: 8.
+ */
+#ifndef CHAOS_GUARD_SETTLE
+#define CHAOS_GUARD_SETTLE     8
+#endif
+
+/**
+ * \brief Track the clock drift at receivers in fixed point, with sub-tick reference times,
+ *        instead of taking the integer skew of the last period.
+ *        Default value: 0 (disabled).
+ */
+#ifndef CHAOS_DRIFT_TRACKING
+#define CHAOS_DRIFT_TRACKING   0
+#endif
+
+/**
+ * \brief Periods the drift tracker averages over once settled (the n-th measurement weighs 1/n before).
+ *        Default value: 16.
+ */
+#ifndef CHAOS_DRIFT_WINDOW
+#define CHAOS_DRIFT_WINDOW     16
+#endif
+
+/**
+ * \brief Change of the skew over a period, in 1/256 low-frequency ticks, that makes the drift tracker
+ *        start over when measured twice in a row: the temperature of the crystal changed.
+ *        Default value: 256 (one tick).
+ */
+#ifndef CHAOS_DRIFT_JUMP
+#define CHAOS_DRIFT_JUMP       256
+#endif
+
 /**
  * \brief Number of consecutive Chaos phases with successful computation of reference time required to exit from bootstrapping.
  *        Default value: 3.
@@ -170,14 +400,164 @@
  */
 #define CHAOS_INIT_GUARD_TIME  (RTIMER_SECOND / 20)                                           //  50 ms
 
+/**
+ * \brief Ask synced neighbors for the schedule after a reboot (see chaos_join) instead of
+ *        bootstrapping: synced nodes listen for requests for CHAOS_JOIN_LISTEN after every
+ *        \link CHAOS_JOIN_SERVE_EVERY \endlink-th round.
+ *        Default value: 0 (disabled).
+ */
+#ifndef CHAOS_FAST_JOIN
+#define CHAOS_FAST_JOIN        0
+#endif
+
+/**
+ * \brief Rounds between two listening windows for join requests, the same rounds
+ *        (by sequence number) at all nodes.
+ *        Default value: 4.
+ */
+#ifndef CHAOS_JOIN_SERVE_EVERY
+#define CHAOS_JOIN_SERVE_EVERY 4
+#endif
+
+/**
+ * \brief Bootstrapping phases spent asking for the schedule before listening for rounds instead.
+ *        Default value: one period more than \link CHAOS_JOIN_SERVE_EVERY \endlink.
+ */
+#ifndef CHAOS_JOIN_PHASES
+#define CHAOS_JOIN_PHASES      ((CHAOS_JOIN_SERVE_EVERY + 1) * CHAOS_PERIOD / CHAOS_INIT_PERIOD)
+#endif
+
 
 /**
  * \brief payload length.
- *        Default value: 100 bytes.
+ *        Default value: 100 bytes, less the atomic broadcast message slots.
  */
 #ifndef PAYLOAD_LEN
+#if CHAOS_ABCAST
+#define PAYLOAD_LEN (100 - 2 * CHAOS_NODES * CHAOS_ABCAST_MSG_LEN - 2 * MERGE_LEN)
+#else
 #define PAYLOAD_LEN 100
 #endif
+#endif
+
+/**
+ * \brief Merge operator applied to the payload, one of CHAOS_MERGE_NONE, CHAOS_MERGE_OR, CHAOS_MERGE_MAX,
+ *        CHAOS_MERGE_TOPK, CHAOS_MERGE_HIST, CHAOS_MERGE_XOR, CHAOS_MERGE_MUX.
+ *        Default value: CHAOS_MERGE_NONE.
+ */
+#ifndef CHAOS_MERGE_OP
+#define CHAOS_MERGE_OP CHAOS_MERGE_NONE
+#endif
+
+/**
+ * \brief Length of the payload chunks tracked by the chunk bitmap.
+ *        Default value: 8 bytes.
+ */
+#ifndef CHAOS_CHUNK_LEN
+#define CHAOS_CHUNK_LEN 8
+#endif
+
+/**
+ * \brief Entries of the list kept by CHAOS_MERGE_TOPK, at the beginning of the payload.
+ *        Default value: 8.
+ */
+#ifndef CHAOS_TOPK_K
+#define CHAOS_TOPK_K 8
+#endif
+
+/**
+ * \brief Node index of unused entries of the top-k list.
+ */
+#define CHAOS_TOPK_NONE 0xffff
+
+/**
+ * \brief Buckets of the histogram kept by CHAOS_MERGE_HIST, at the beginning of the payload.
+ *        Each bucket is a bitmap of \link MERGE_LEN \endlink bytes showing the nodes
+ *        whose value falls into it: duplicates do not count twice.
+ *        Default value: 8.
+ */
+#ifndef CHAOS_HIST_BUCKETS
+#define CHAOS_HIST_BUCKETS 8
+#endif
+
+/**
+ * \brief Blocks of \link PAYLOAD_LEN \endlink bytes of the object disseminated
+ *        by CHAOS_MERGE_XOR, at most 16 (one coefficient bit each).
+ *        Default value: 8.
+ */
+#ifndef CHAOS_NC_BLOCKS
+#define CHAOS_NC_BLOCKS 8
+#endif
+
+/**
+ * \brief Sections of the payload merged by CHAOS_MERGE_MUX, as \link chaos_mux_section \endlink
+ *        initializers: sessions that would otherwise need a round each share one.
+ *        Default value: a bitmap of yes votes, a temperature (maximum) and a bitmap
+ *        of the nodes present, which must be full for the round to complete.
+ */
+#ifndef CHAOS_MUX_SECTIONS
+#define CHAOS_MUX_SECTIONS { \
+	{0, MERGE_LEN, CHAOS_MERGE_OR, CHAOS_MUX_DONE_FLAGS}, \
+	{MERGE_LEN, 1, CHAOS_MERGE_MAX, CHAOS_MUX_DONE_FLAGS}, \
+	{MERGE_LEN + 1, MERGE_LEN, CHAOS_MERGE_OR, CHAOS_MUX_DONE_FULL}}
+#endif
+
+/**
+ * \brief Bytes at the start of the payload spanned by \link CHAOS_MUX_SECTIONS \endlink:
+ *        sections beyond it are skipped.
+ *        Default value: the span of the default sections.
+ */
+#ifndef CHAOS_MUX_LEN
+#define CHAOS_MUX_LEN (2 * MERGE_LEN + 1)
+#endif
+
+#if CHAOS_MERGE_OP == CHAOS_MERGE_MUX && CHAOS_MUX_LEN > PAYLOAD_LEN
+#error "CHAOS_MUX_SECTIONS do not fit in PAYLOAD_LEN: check CHAOS_MUX_LEN"
+#endif
+#if CHAOS_MERGE_OP == CHAOS_MERGE_XOR && CHAOS_NC_BLOCKS > 16
+#error "CHAOS_NC_BLOCKS: at most 16 blocks"
+#endif
+#if CHAOS_MERGE_OP == CHAOS_MERGE_XOR && PAYLOAD_LEN % 2
+#error "CHAOS_MERGE_XOR codes words: PAYLOAD_LEN must be even"
+#endif
+#if CHAOS_MERGE_OP == CHAOS_MERGE_TOPK && CHAOS_TOPK_K * 4 > PAYLOAD_LEN
+#error "CHAOS_TOPK_K entries do not fit in PAYLOAD_LEN"
+#endif
+#if CHAOS_MERGE_OP == CHAOS_MERGE_HIST && CHAOS_HIST_BUCKETS * MERGE_LEN > PAYLOAD_LEN
+#error "CHAOS_HIST_BUCKETS buckets do not fit in PAYLOAD_LEN"
+#endif
+#if CHAOS_ABCAST && (PAYLOAD_LEN < 2 || 2 * CHAOS_NODES * CHAOS_ABCAST_MSG_LEN + 2 * MERGE_LEN + PAYLOAD_LEN > 100)
+#error "CHAOS_ABCAST: the message slots of CHAOS_NODES nodes do not fit next to PAYLOAD_LEN, reduce CHAOS_ABCAST_MSG_LEN"
+#endif
+#if CHAOS_ADAPTIVE_GUARD && (CHAOS_GUARD_SETTLE < 1 || CHAOS_GUARD_SETTLE > 255)
+#error "CHAOS_GUARD_SETTLE: between 1 and 255 wake-up errors"
+#endif
+
+/**
+ * \brief Entry of the top-k list, sorted by decreasing value and then increasing node index.
+ */
+typedef struct {
+	uint16_t value; /**< Value, zero if unused. */
+	uint16_t node;  /**< Index of the node reporting it, \link CHAOS_TOPK_NONE \endlink if unused. */
+} chaos_topk_entry;
+
+/**
+ * \brief Check a section: known operator, within \link CHAOS_MUX_LEN \endlink, and a full
+ *        node bitmap if it completes when full.
+ */
+#define CHAOS_MUX_SECTION_OK(sec)   ((sec)->op <= CHAOS_MERGE_MAX && (sec)->len && \
+		(sec)->offset + (sec)->len <= CHAOS_MUX_LEN && \
+		((sec)->done != CHAOS_MUX_DONE_FULL || (sec)->len >= MERGE_LEN))
+
+/**
+ * \brief Number of payload chunks.
+ */
+#define CHAOS_CHUNKS ((PAYLOAD_LEN + CHAOS_CHUNK_LEN - 1) / CHAOS_CHUNK_LEN)
+
+/**
+ * \brief Length of the chunk bitmap.
+ */
+#define CHAOS_CHUNK_MAP_LEN ((CHAOS_CHUNKS / 8) + ((CHAOS_CHUNKS % 8) ? 1 : 0))
 
 /**
  * \brief Data structure used to represent Chaos data.
@@ -185,7 +565,36 @@
 typedef struct {
 	unsigned long seq_no; /**< Sequence number, incremented by the initiator at each Chaos phase. */
 	uint8_t flags[MERGE_LEN]; /**< Flags, showing which nodes already contributed. */
-	uint8_t payload[PAYLOAD_LEN]; /**< Payload, this is the application data. */
+#if CHAOS_AGREE
+	uint8_t agree_id; /**< Identifier of the proposal being voted on, zero if none. */
+	uint8_t agree_decision; /**< Outcome of the proposal decided by the initiator,
+	                             \link CHAOS_AGREE_UNDECIDED \endlink while voting. */
+	uint16_t agree_value; /**< Proposed value. */
+	uint8_t votes[MERGE_LEN]; /**< Yes votes; a flag without vote is a vote against the proposal. */
+#endif /* CHAOS_AGREE */
+#if CHAOS_ABCAST
+	uint8_t abcast_map[2][MERGE_LEN]; /**< Message slots in use, for even and odd rounds. */
+	uint8_t abcast_msg[2][CHAOS_NODES][CHAOS_ABCAST_MSG_LEN]; /**< Message slots, one per node,
+	                                                               for even and odd rounds. */
+#endif /* CHAOS_ABCAST */
+#if CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+	uint16_t nc_coeffs; /**< Blocks of the object combined in the payload, one bit each. */
+	uint8_t nc_rank; /**< Blocks of the object the sender can decode so far. */
+#endif /* CHAOS_MERGE_OP */
+#if CHAOS_SCHED
+	uint8_t sched_apps; /**< Applications taking part in the round, set by the initiator. */
+#endif /* CHAOS_SCHED */
+#if CHAOS_MEMBERSHIP
+	uint16_t join_id; /**< Node ID asking for an index, zero if none (the lowest one wins). */
+	uint16_t grant_id; /**< Node ID the initiator granted an index to, zero if none. */
+	uint16_t grant_index; /**< Index granted to grant_id. */
+	uint8_t members[MERGE_LEN]; /**< Indexes in use, set by the initiator: only their flags are needed for completion. */
+	uint8_t leaving[MERGE_LEN]; /**< Members giving back their index. */
+#endif /* CHAOS_MEMBERSHIP */
+	uint8_t chunks[CHAOS_CHUNK_MAP_LEN]; /**< Payload chunks holding data of at least one node,
+	                                          the merge operator skips the others. */
+	uint8_t payload[PAYLOAD_LEN] __attribute__((aligned(2))); /**< Payload, this is the application data
+	                                                             (word aligned for the merge operators). */
 } chaos_data_struct;
 
 /** @} */
@@ -201,21 +610,63 @@ typedef struct {
 #define DATA_LEN                    sizeof(chaos_data_struct)
 
 /**
- * \brief synchronization on/off
+ * \brief synchronization on/off: CHAOS_SYNC runs periodic rounds,
+ *        CHAOS_NO_SYNC event-triggered ones after a low-power-listening wake-up.
  */
+#ifndef CHAOS_SYNC_MODE
 #define CHAOS_SYNC_MODE CHAOS_SYNC
 //#define CHAOS_SYNC_MODE CHAOS_NO_SYNC
+#endif
+
+/**
+ * \brief Flooding data, kept in place inside the Chaos packet buffer.
+ * \sa \link chaos_get_data \endlink
+ */
+#define CHAOS_DATA                  ((chaos_data_struct *)chaos_get_data())
 
 /**
  * \brief Check if the nodeId matches the one of the initiator.
  */
 #define IS_INITIATOR()              (node_id == INITIATOR_NODE_ID)
 
+#if CHAOS_CLUSTERED
+/**
+ * \brief Number of nodes in the whole network.
+ */
+#define CHAOS_NETWORK_NODES         (CHAOS_NODES * CHAOS_NODES)
+
+/**
+ * \brief Check if the node is the head of its cluster: it starts the local rounds
+ *        and takes part in the backbone ones.
+ */
+#define IS_CLUSTER_HEAD()           (node_index == 0)
+
+/**
+ * \brief Index of the node in the whole network (node_index is the one within the cluster).
+ */
+#define CHAOS_GLOBAL_INDEX()        (cluster_id * CHAOS_NODES + node_index)
+#else
+#define CHAOS_NETWORK_NODES         CHAOS_NODES
+#define IS_CLUSTER_HEAD()           0
+#define CHAOS_GLOBAL_INDEX()        (node_index)
+#endif /* CHAOS_CLUSTERED */
+
+/**
+ * \brief Sequence number a receiver expects for the next round.
+ */
+#define CHAOS_NEXT_SEQ_NO()         (CHAOS_DATA->seq_no + 1 + sync_missed)
+
+/**
+ * \brief Check if the node starts the next round itself in case nobody else does.
+ * \sa \link CHAOS_MULTI_INITIATOR \endlink.
+ */
+#define IS_INITIATOR_CANDIDATE()    (IS_INITIATOR() || failover_active || sync_missed >= CHAOS_FAILOVER_PERIODS)
+
 /**
- * \brief Check if Chaos is still bootstrapping.
+ * \brief Check if Chaos is still bootstrapping (never without synchronization).
  * \sa \link CHAOS_BOOTSTRAP_PERIODS \endlink.
  */
-#define CHAOS_IS_BOOTSTRAPPING()   (skew_estimated < CHAOS_BOOTSTRAP_PERIODS)
+#define CHAOS_IS_BOOTSTRAPPING()   (CHAOS_SYNC_MODE && skew_estimated < CHAOS_BOOTSTRAP_PERIODS)
 
 /**
  * \brief Check if Chaos is synchronized.
@@ -123,12 +123,7 @@ cc2420_set_channel(int c)
 {
   uint16_t f;
 
-  /*
-   * Subtract the base channel (11), multiply by 5, which is the
-   * channel spacing. 357 is 2405-2048 and 0x4000 is LOCK_THR = 1.
-   */
-
-  f = 5 * (c - 11) + 357 + 0x4000;
+  f = CC2420_FSCTRL_CHANNEL(c);
   /*
    * Writing RAM requires crystal oscillator to be stable.
    */
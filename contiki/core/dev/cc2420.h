@@ -46,6 +46,11 @@
 int cc2420_init(void);
 void cc2420_set_channel(int channel);
 void cc2420_set_tx_power(int power);
+/*
+ * FSCTRL value for channel c: subtract the base channel (11), multiply by 5,
+ * which is the channel spacing. 357 is 2405-2048 and 0x4000 is LOCK_THR = 1.
+ */
+#define CC2420_FSCTRL_CHANNEL(c) (5 * ((c) - 11) + 357 + 0x4000)
 #define CC2420_TXPOWER_MAX  31
 #define CC2420_TXPOWER_MIN   0
 
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Ordered atomic broadcast on top of Chaos, source file.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#include "chaos-abcast.h"
+
+#if CHAOS_ABCAST
+
+#define SLOT_SET(s)              ((uint8_t)((s) & 1))
+#define SLOT(d, set, node)       ((d)->abcast_msg[set][node])
+
+static chaos_abcast_deliver_t deliver_fn;
+static uint8_t queue[CHAOS_ABCAST_QUEUE_LEN][CHAOS_ABCAST_MSG_LEN];
+static uint8_t queue_head, queue_cnt;
+static uint8_t sent_msg[CHAOS_ABCAST_MSG_LEN]; // own message of the last round, sent again in this one
+static uint8_t sent_valid;
+static uint8_t cur_valid;                      // own message in the current round
+static unsigned long round_seq;                // sequence number of the current round
+static unsigned long collected_seq;            // round whose messages are in the flooding data
+static unsigned long delivered_seq;            // last round delivered
+static unsigned long deliver_from, deliver_to; // rounds to deliver by chaos_abcast_process
+static unsigned long lost_from;                // rounds lost_from to deliver_from - 1 are reported lost
+static volatile uint8_t accepted;              // not zero if our slots have been merged in this round
+
+PROCESS(chaos_abcast_process, "Chaos atomic broadcast");
+PROCESS_THREAD(chaos_abcast_process, ev, data)
+{
+	PROCESS_BEGIN();
+
+	while(1) {
+		PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+		// the flooding data stays untouched until the next round is prepared
+		chaos_data_struct *d = CHAOS_DATA;
+		unsigned long s;
+		uint16_t i;
+		for (s = lost_from; s < deliver_from; s++) {
+			// we missed the completion of this round and the next one: its messages are gone
+			if (deliver_fn) {
+				deliver_fn(s, CHAOS_NODES, NULL);
+			}
+		}
+		for (s = deliver_from; s <= deliver_to; s++) {
+			for (i = 0; i < CHAOS_NODES; i++) {
+				if (deliver_fn && (d->abcast_map[SLOT_SET(s)][i / 8] & (1 << (i % 8)))) {
+					deliver_fn(s, i, SLOT(d, SLOT_SET(s), i));
+				}
+			}
+		}
+	}
+
+	PROCESS_END();
+}
+
+void chaos_abcast_init(chaos_abcast_deliver_t deliver) {
+	deliver_fn = deliver;
+	process_start(&chaos_abcast_process, NULL);
+}
+
+uint8_t chaos_abcast_send(const uint8_t *msg) {
+	if (queue_cnt == CHAOS_ABCAST_QUEUE_LEN) {
+		return 0;
+	}
+	memcpy(queue[(queue_head + queue_cnt) % CHAOS_ABCAST_QUEUE_LEN], msg, CHAOS_ABCAST_MSG_LEN);
+	queue_cnt++;
+	return 1;
+}
+
+void chaos_abcast_prepare(unsigned long seq_no, uint8_t initiator_) {
+	chaos_data_struct *d = CHAOS_DATA;
+	uint8_t cur = SLOT_SET(seq_no), prev = cur ^ 1;
+	if (collected_seq != seq_no - 1) {
+		// we do not have the messages of the last round
+		memset(d->abcast_map[prev], 0, MERGE_LEN);
+	}
+	memset(d->abcast_map[cur], 0, MERGE_LEN);
+	if (node_index < CHAOS_NODES) {
+		if (sent_valid) {
+			memcpy(SLOT(d, prev, node_index), sent_msg, CHAOS_ABCAST_MSG_LEN);
+			d->abcast_map[prev][node_index / 8] |= 1 << (node_index % 8);
+		}
+		cur_valid = (queue_cnt > 0);
+		if (cur_valid) {
+			memcpy(SLOT(d, cur, node_index), queue[queue_head], CHAOS_ABCAST_MSG_LEN);
+			d->abcast_map[cur][node_index / 8] |= 1 << (node_index % 8);
+		}
+	}
+	round_seq = seq_no;
+	// whatever the initiator floods is the round
+	accepted = initiator_;
+}
+
+uint8_t chaos_abcast_processing(chaos_data_struct *local, chaos_data_struct *received) {
+	uint8_t changed = 0;
+	uint8_t set, missing;
+	uint16_t i, node;
+	if (received->seq_no != round_seq) {
+		// our slots belong to another round: keep them for the next one
+		return 0;
+	}
+	accepted = 1;
+	for (set = 0; set < 2; set++) {
+		for (i = 0; i < MERGE_LEN; i++) {
+			missing = local->abcast_map[set][i] & ~received->abcast_map[set][i];
+			if (!missing) {
+				continue;
+			}
+			received->abcast_map[set][i] |= missing;
+			changed = 1;
+			for (node = i * 8; missing; node++, missing >>= 1) {
+				if (missing & 1) {
+					memcpy(SLOT(received, set, node), SLOT(local, set, node), CHAOS_ABCAST_MSG_LEN);
+				}
+			}
+		}
+	}
+	return changed;
+}
+
+void chaos_abcast_round_end(void) {
+	if (accepted) {
+		// our message made it into the round: it goes out once more in the next one
+		sent_valid = cur_valid;
+		if (cur_valid) {
+			memcpy(sent_msg, queue[queue_head], CHAOS_ABCAST_MSG_LEN);
+			queue_head = (queue_head + 1) % CHAOS_ABCAST_QUEUE_LEN;
+			queue_cnt--;
+		}
+		collected_seq = round_seq;
+	} else {
+		// send it again in the next round
+		sent_valid = 0;
+		collected_seq = 0;
+	}
+	if (accepted && get_rx_cnt() && get_complete() == CHAOS_COMPLETE) {
+		// all nodes contributed: we have the messages of this round and the last one
+		if (!delivered_seq || delivered_seq >= round_seq) {
+			// nothing delivered so far (or the sequence restarted)
+			deliver_from = round_seq - 1;
+			lost_from = deliver_from;
+		} else {
+			// the rounds in between are undelivered for good
+			deliver_from = (delivered_seq == round_seq - 1) ? round_seq : round_seq - 1;
+			lost_from = delivered_seq + 1;
+		}
+		deliver_to = round_seq;
+		delivered_seq = round_seq;
+		process_poll(&chaos_abcast_process);
+	}
+}
+
+#endif /* CHAOS_ABCAST */
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Ordered atomic broadcast on top of Chaos, header file.
+ *
+ *         Every node owns one message slot per round. A round carries the
+ *         messages of the current round and, again, the ones of the previous
+ *         round, in two slot sets selected by the parity of the sequence number.
+ *         A node that completes a round (all flags set) holds the messages of all
+ *         nodes for that round and the previous one, and delivers them ordered by
+ *         sequence number and then by node index: all nodes deliver the same
+ *         sequence, at most two rounds after a message has been sent. A node
+ *         missing the completion of two rounds in a row has lost the messages of
+ *         the first one: it reports that round lost, in its place in the sequence.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#ifndef CHAOS_ABCAST_H_
+#define CHAOS_ABCAST_H_
+
+#include "chaos.h"
+#include "chaos-test.h"
+
+/**
+ * Messages a node can queue while waiting for its slot.
+ */
+#ifndef CHAOS_ABCAST_QUEUE_LEN
+#define CHAOS_ABCAST_QUEUE_LEN          4
+#endif
+
+/**
+ * \brief            Deliver a message, from process context.
+ * \param seq_no     Sequence number of the round the message was sent in.
+ * \param node       Index of the sender, \link CHAOS_NODES \endlink if the round is lost.
+ * \param msg        Message, \link CHAOS_ABCAST_MSG_LEN \endlink bytes, NULL if the round is lost.
+ */
+typedef void (*chaos_abcast_deliver_t)(unsigned long seq_no, uint16_t node, const uint8_t *msg);
+
+/**
+ * \defgroup chaos_abcast Interface related to atomic broadcast
+ * @{
+ */
+
+/**
+ * \brief            Set up the atomic broadcast module, on all nodes.
+ * \param deliver    Function called for each delivered message, in delivery order.
+ */
+void chaos_abcast_init(chaos_abcast_deliver_t deliver);
+
+/**
+ * \brief            Queue a message, sent in the next round with a free slot.
+ * \param msg        Message, \link CHAOS_ABCAST_MSG_LEN \endlink bytes.
+ * \returns          Zero if the queue is full.
+ */
+uint8_t chaos_abcast_send(const uint8_t *msg);
+
+/**
+ * \brief            Fill the message slots of the flooding data,
+ *                   before \link chaos_start \endlink.
+ * \param seq_no     Sequence number of the round (expected one at receivers).
+ * \param initiator_ Not zero if the node starts the round.
+ */
+void chaos_abcast_prepare(unsigned long seq_no, uint8_t initiator_);
+
+/**
+ * \brief            Deliver the messages of the rounds completed,
+ *                   after \link chaos_stop \endlink.
+ */
+void chaos_abcast_round_end(void);
+
+/**
+ * \brief            Merge the message slots.
+ *
+ *                   Called by Chaos while processing a received packet.
+ * \returns          Not zero if the received data has changed.
+ */
+uint8_t chaos_abcast_processing(chaos_data_struct *local, chaos_data_struct *received);
+
+/** @} */
+
+#endif /* CHAOS_ABCAST_H_ */
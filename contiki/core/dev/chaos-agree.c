@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Network-wide agreement on top of Chaos, source file.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#include "chaos-agree.h"
+
+#if CHAOS_AGREE
+
+static chaos_agree_vote_t vote_fn;
+static chaos_agree_result_t result_fn;
+static uint8_t last_id;       // identifier of the last proposal started here
+static uint8_t pending_id;    // proposal started here and still undecided, zero if none
+static uint16_t pending_value;
+static uint8_t pending_rounds;
+static uint8_t decided_id;    // proposal decided here, whose decision is flooded next, zero if none
+static uint16_t decided_value;
+static uint8_t decided_outcome;
+static uint8_t reported_id;   // last proposal whose outcome has been reported
+static uint16_t reported_value;
+static uint8_t reported_outcome;
+
+PROCESS(chaos_agree_process, "Chaos agreement");
+PROCESS_THREAD(chaos_agree_process, ev, data)
+{
+	PROCESS_BEGIN();
+
+	while(1) {
+		PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+		if (result_fn) {
+			result_fn(reported_value, reported_outcome);
+		}
+	}
+
+	PROCESS_END();
+}
+
+static inline uint8_t vote(uint16_t proposal) {
+	return vote_fn ? vote_fn(proposal) : 1;
+}
+
+static inline void set_my_vote(chaos_data_struct *d) {
+	if (node_index / 8 < MERGE_LEN) {
+		d->votes[node_index / 8] |= 1 << (node_index % 8);
+	}
+}
+
+static inline uint8_t outcome_of(chaos_data_struct *d) {
+	uint16_t i;
+	for (i = 0; i < MERGE_LEN; i++) {
+		if (d->flags[i] & ~d->votes[i]) {
+			// a node voted no: no need to wait for the others
+			return CHAOS_AGREE_ABORT;
+		}
+	}
+	// all flags (of members) set, as merged by Chaos
+	return (get_complete() == CHAOS_COMPLETE) ? CHAOS_AGREE_COMMIT : CHAOS_AGREE_UNDECIDED;
+}
+
+void chaos_agree_init(chaos_agree_vote_t vote, chaos_agree_result_t result) {
+	vote_fn = vote;
+	result_fn = result;
+	process_start(&chaos_agree_process, NULL);
+}
+
+uint8_t chaos_agree_start(uint16_t proposal) {
+	if (pending_id || decided_id) {
+		return 0;
+	}
+	if (++last_id == 0) {
+		// zero means no proposal
+		last_id = 1;
+	}
+	pending_id = last_id;
+	pending_value = proposal;
+	pending_rounds = 0;
+	return 1;
+}
+
+void chaos_agree_prepare(uint8_t initiator_) {
+	chaos_data_struct *d = CHAOS_DATA;
+	memset(d->votes, 0, MERGE_LEN);
+	d->agree_decision = CHAOS_AGREE_UNDECIDED;
+	if (initiator_ && decided_id) {
+		// flood the decision
+		d->agree_id = decided_id;
+		d->agree_value = decided_value;
+		d->agree_decision = decided_outcome;
+	} else if (initiator_ && pending_id) {
+		d->agree_id = pending_id;
+		d->agree_value = pending_value;
+		if (vote(pending_value)) {
+			set_my_vote(d);
+		}
+	} else {
+		// receivers vote when they receive the proposal
+		d->agree_id = 0;
+	}
+}
+
+uint8_t chaos_agree_processing(chaos_data_struct *local, chaos_data_struct *received) {
+	uint8_t changed = 0;
+	uint16_t i;
+	if (received->agree_id != local->agree_id) {
+		if (!received->agree_id) {
+			// the sender does not know the proposal yet: pass on ours
+			received->agree_id = local->agree_id;
+			received->agree_value = local->agree_value;
+			received->agree_decision = local->agree_decision;
+			memcpy(received->votes, local->votes, MERGE_LEN);
+			return 1;
+		}
+		// first time we see this proposal: vote into the received data,
+		// the local one is not merged and still is in the TXFIFO
+		// (nodes without a flag index do not vote)
+		if (!received->agree_decision && node_index / 8 < MERGE_LEN && vote(received->agree_value)) {
+			uint8_t bit = 1 << (node_index % 8);
+			changed = !(received->votes[node_index / 8] & bit);
+			set_my_vote(received);
+		}
+		return changed;
+	}
+	if (!received->agree_decision && local->agree_decision) {
+		// only the initiator decides: pass the decision on
+		received->agree_decision = local->agree_decision;
+		changed = 1;
+	}
+	for (i = 0; i < MERGE_LEN; i++) {
+		changed |= (local->votes[i] & ~received->votes[i]);
+		received->votes[i] |= local->votes[i];
+	}
+	return changed;
+}
+
+void chaos_agree_round_end(void) {
+	chaos_data_struct *d = CHAOS_DATA;
+	uint8_t outcome = CHAOS_AGREE_UNDECIDED;
+	if (decided_id) {
+		// the decision went out in this round
+		decided_id = 0;
+	}
+	if (pending_id && d->agree_id == pending_id) {
+		// our proposal was flooded: votes of other nodes are only known after a reception
+		if (get_rx_cnt()) {
+			outcome = outcome_of(d);
+		}
+		if (outcome == CHAOS_AGREE_UNDECIDED && ++pending_rounds >= CHAOS_AGREE_ROUNDS) {
+			// give up: nodes that did not receive the proposal do not vote against it
+			outcome = CHAOS_AGREE_ABORT;
+		}
+		if (outcome != CHAOS_AGREE_UNDECIDED) {
+			// flood the decision in the next round, the one reported everywhere
+			decided_id = pending_id;
+			decided_value = pending_value;
+			decided_outcome = outcome;
+			pending_id = 0;
+		}
+		return;
+	}
+	if (d->agree_id && d->agree_decision && d->agree_id != reported_id) {
+		// the initiator's decision, the same on every node that received it
+		reported_id = d->agree_id;
+		reported_value = d->agree_value;
+		reported_outcome = d->agree_decision;
+		process_poll(&chaos_agree_process);
+	}
+}
+
+#endif /* CHAOS_AGREE */
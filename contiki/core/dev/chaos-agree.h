@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Network-wide agreement on top of Chaos, header file.
+ *
+ *         The initiator proposes a value and every node votes on it while
+ *         relaying. From the merged data the initiator decides whether the
+ *         proposal is committed (all nodes voted yes) or aborted (at least
+ *         one node voted no, or no outcome within CHAOS_AGREE_ROUNDS rounds),
+ *         and floods the decision in the next round: nodes only report the
+ *         decision of the initiator, so no two nodes report different outcomes.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#ifndef CHAOS_AGREE_H_
+#define CHAOS_AGREE_H_
+
+#include "chaos.h"
+#include "chaos-test.h"
+
+/**
+ * Rounds the initiator keeps proposing the same value while the outcome is
+ * still undecided (flags incomplete and no vote against) before deciding to abort.
+ */
+#ifndef CHAOS_AGREE_ROUNDS
+#define CHAOS_AGREE_ROUNDS              2
+#endif
+
+/**
+ * Outcome of an agreement.
+ */
+enum {
+	CHAOS_AGREE_UNDECIDED = 0, /**< not all votes collected yet */
+	CHAOS_AGREE_COMMIT = 1,    /**< all nodes voted yes */
+	CHAOS_AGREE_ABORT = 2      /**< at least one node voted no, or no outcome within \link CHAOS_AGREE_ROUNDS \endlink */
+};
+
+/**
+ * \brief            Vote on a proposal.
+ *
+ *                   Called from the SFD interrupt when the node first receives
+ *                   a proposal, within the \link PROCESSING_CYCLES \endlink budget:
+ *                   it must return right away, e.g., by checking a precomputed table.
+ * \returns          Not zero to vote yes, zero to vote no.
+ */
+typedef uint8_t (*chaos_agree_vote_t)(uint16_t proposal);
+
+/**
+ * \brief            Get the outcome of a proposal, from process context.
+ */
+typedef void (*chaos_agree_result_t)(uint16_t proposal, uint8_t outcome);
+
+/**
+ * \defgroup chaos_agree Interface related to network-wide agreement
+ * @{
+ */
+
+/**
+ * \brief            Set up the agreement module, on all nodes.
+ * \param vote       Function voting on proposals, NULL to always vote yes.
+ * \param result     Function called once per proposal with its outcome.
+ */
+void chaos_agree_init(chaos_agree_vote_t vote, chaos_agree_result_t result);
+
+/**
+ * \brief            Propose a value, at the initiator.
+ *
+ *                   The proposal is flooded from the next round on;
+ *                   the outcome is reported through the result function.
+ * \returns          Zero if another proposal is still pending.
+ */
+uint8_t chaos_agree_start(uint16_t proposal);
+
+/**
+ * \brief            Prepare the agreement fields of the flooding data,
+ *                   before \link chaos_start \endlink.
+ * \param initiator_ Not zero if the node starts the round.
+ */
+void chaos_agree_prepare(uint8_t initiator_);
+
+/**
+ * \brief            At the initiator, decide on the current proposal from the
+ *                   merged data; at every node, report a decision flooded in
+ *                   the round. After \link chaos_stop \endlink.
+ */
+void chaos_agree_round_end(void);
+
+/**
+ * \brief            Merge the agreement fields, voting on new proposals.
+ *
+ *                   Called by Chaos while processing a received packet.
+ * \returns          Not zero if the received data has changed.
+ */
+uint8_t chaos_agree_processing(chaos_data_struct *local, chaos_data_struct *received);
+
+/** @} */
+
+#endif /* CHAOS_AGREE_H_ */
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Dynamic membership for Chaos, source file.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#include "chaos-member.h"
+
+#if CHAOS_MEMBERSHIP
+
+#if (CHAOS_MEMBER_HASH_LEN & (CHAOS_MEMBER_HASH_LEN - 1)) || CHAOS_MEMBER_HASH_LEN <= CHAOS_NODES
+#error "CHAOS_MEMBER_HASH_LEN must be a power of two larger than CHAOS_NODES"
+#endif
+
+#define HASH_EMPTY               0
+#define HASH_DELETED             0xffff
+#define BIT_IS_SET(map, i)       ((map)[(i) / 8] & (1 << ((i) % 8)))
+
+static uint8_t leaving;      // not zero after chaos_member_leave
+static uint8_t missed;       // consecutive rounds without reception, at members
+
+/* initiator state */
+static uint16_t ids[CHAOS_NODES];                 // node ID of each index, zero if free
+static uint16_t hash[CHAOS_MEMBER_HASH_LEN];      // index + 1 of node IDs, open addressing
+static uint8_t flag_missed[CHAOS_NODES];          // consecutive rounds without the flag of each index
+static uint8_t members[MERGE_LEN];
+static uint16_t grant_id, grant_index;
+static uint16_t next_free;                        // allocation is round-robin to delay reuse
+
+static inline uint16_t hash_slot(uint16_t id) {
+	// node IDs are mostly consecutive: the low bits spread them well
+	return id & (CHAOS_MEMBER_HASH_LEN - 1);
+}
+
+uint16_t chaos_member_lookup(uint16_t id) {
+	uint16_t h = hash_slot(id);
+	uint16_t n;
+	for (n = 0; n < CHAOS_MEMBER_HASH_LEN && hash[h] != HASH_EMPTY; n++) {
+		if (hash[h] != HASH_DELETED && ids[hash[h] - 1] == id) {
+			return hash[h] - 1;
+		}
+		h = (h + 1) & (CHAOS_MEMBER_HASH_LEN - 1);
+	}
+	return CHAOS_NO_INDEX;
+}
+
+static void member_add(uint16_t id, uint16_t index) {
+	uint16_t h = hash_slot(id);
+	while (hash[h] != HASH_EMPTY && hash[h] != HASH_DELETED) {
+		h = (h + 1) & (CHAOS_MEMBER_HASH_LEN - 1);
+	}
+	hash[h] = index + 1;
+	ids[index] = id;
+	flag_missed[index] = 0;
+	members[index / 8] |= 1 << (index % 8);
+}
+
+static void member_remove(uint16_t index) {
+	uint16_t h = hash_slot(ids[index]);
+	while (hash[h] != index + 1) {
+		h = (h + 1) & (CHAOS_MEMBER_HASH_LEN - 1);
+	}
+	hash[h] = HASH_DELETED;
+	ids[index] = 0;
+	members[index / 8] &= ~(1 << (index % 8));
+}
+
+static uint16_t member_join(uint16_t id) {
+	uint16_t index = chaos_member_lookup(id);
+	uint16_t n;
+	if (index != CHAOS_NO_INDEX) {
+		// it missed the grant: same index again
+		return index;
+	}
+	for (n = 0; n < CHAOS_NODES; n++) {
+		index = next_free;
+		next_free = (next_free + 1) % CHAOS_NODES;
+		if (!ids[index]) {
+			member_add(id, index);
+			return index;
+		}
+	}
+	return CHAOS_NO_INDEX;
+}
+
+uint8_t chaos_member_init(uint8_t initiator_) {
+	if (initiator_) {
+		member_add(node_id, 0);
+		next_free = 1;
+		node_index = 0;
+	} else {
+		node_index = CHAOS_NO_INDEX;
+	}
+	return 1;
+}
+
+void chaos_member_leave(void) {
+	leaving = 1;
+}
+
+void chaos_member_prepare(uint8_t initiator_) {
+	chaos_data_struct *d = CHAOS_DATA;
+	if (initiator_) {
+		memcpy(d->members, members, MERGE_LEN);
+		d->grant_id = grant_id;
+		d->grant_index = grant_index;
+	}
+	memset(d->leaving, 0, MERGE_LEN);
+	if (node_index == CHAOS_NO_INDEX) {
+		d->join_id = leaving ? 0 : node_id;
+	} else {
+		d->join_id = 0;
+		if (leaving) {
+			d->leaving[node_index / 8] |= 1 << (node_index % 8);
+		}
+	}
+}
+
+uint8_t chaos_member_processing(chaos_data_struct *local, chaos_data_struct *received) {
+	uint8_t changed = 0;
+	uint16_t i;
+	if (local->join_id && (!received->join_id || local->join_id < received->join_id)) {
+		// one join per round: the lowest node ID
+		received->join_id = local->join_id;
+		changed = 1;
+	}
+	for (i = 0; i < MERGE_LEN; i++) {
+		changed |= (local->leaving[i] & ~received->leaving[i]);
+		received->leaving[i] |= local->leaving[i];
+	}
+	return changed;
+}
+
+void chaos_member_round_end(uint8_t initiator_) {
+	chaos_data_struct *d = CHAOS_DATA;
+	uint16_t i;
+	if (!get_rx_cnt()) {
+		if (node_index != CHAOS_NO_INDEX && !initiator_ && ++missed >= CHAOS_MEMBER_TIMEOUT) {
+			// the initiator reclaims our index as well: join again later
+			node_index = CHAOS_NO_INDEX;
+		}
+		return;
+	}
+	missed = 0;
+	if (initiator_) {
+		for (i = 1; i < CHAOS_NODES; i++) {
+			if (!ids[i]) {
+				continue;
+			}
+			if (BIT_IS_SET(d->leaving, i)) {
+				member_remove(i);
+			} else if (BIT_IS_SET(d->flags, i)) {
+				flag_missed[i] = 0;
+			} else if (++flag_missed[i] >= CHAOS_MEMBER_TIMEOUT) {
+				// dead: stop waiting for it
+				member_remove(i);
+			}
+		}
+		// each grant is flooded for one round: a node that misses it asks again
+		// and gets the same index
+		grant_index = d->join_id ? member_join(d->join_id) : CHAOS_NO_INDEX;
+		grant_id = (grant_index != CHAOS_NO_INDEX) ? d->join_id : 0;
+		return;
+	}
+	if (node_index == CHAOS_NO_INDEX) {
+		if (!leaving && d->grant_id == node_id) {
+			node_index = d->grant_index;
+		}
+	} else if (!BIT_IS_SET(d->members, node_index)) {
+		// index reclaimed, or leave done
+		node_index = CHAOS_NO_INDEX;
+	}
+}
+
+#endif /* CHAOS_MEMBERSHIP */
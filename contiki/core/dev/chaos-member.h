@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Dynamic membership for Chaos, header file.
+ *
+ *         Flag indexes are allocated at runtime by the initiator, which keeps
+ *         the only node ID to index table. A node without index asks for one
+ *         through the join field of the flooding data (the lowest node ID wins
+ *         a round) and learns it from the grant the initiator floods in the next
+ *         round. Members leave through a bitmap, and the initiator reclaims the
+ *         indexes of nodes whose flag has been missing for
+ *         \link CHAOS_MEMBER_TIMEOUT \endlink rounds. The members bitmap flooded
+ *         by the initiator tells which flags are needed for completion.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#ifndef CHAOS_MEMBER_H_
+#define CHAOS_MEMBER_H_
+
+#include "chaos.h"
+#include "chaos-test.h"
+
+/**
+ * Rounds without the flag of a member (or, at the member, without any
+ * reception) after which its index is reclaimed.
+ */
+#ifndef CHAOS_MEMBER_TIMEOUT
+#define CHAOS_MEMBER_TIMEOUT            8
+#endif
+
+/**
+ * Entries of the node ID to index hash table at the initiator,
+ * a power of two larger than \link CHAOS_NODES \endlink.
+ */
+#ifndef CHAOS_MEMBER_HASH_LEN
+#define CHAOS_MEMBER_HASH_LEN           ((CHAOS_NODES < 128) ? 256 : 1024)
+#endif
+
+/**
+ * Node index of nodes that are not members.
+ */
+#define CHAOS_NO_INDEX                  0xffff
+
+/**
+ * \defgroup chaos_member Interface related to dynamic membership
+ * @{
+ */
+
+/**
+ * \brief            Set up the membership module.
+ * \param initiator_ Not zero at the initiator, which takes index zero.
+ * \returns          Not zero.
+ */
+uint8_t chaos_member_init(uint8_t initiator_);
+
+/**
+ * \brief            Leave the network: the index is given back in the next rounds.
+ */
+void chaos_member_leave(void);
+
+/**
+ * \brief            Get the index of a node, at the initiator.
+ * \param id         Node ID.
+ * \returns          Its index, \link CHAOS_NO_INDEX \endlink if not a member.
+ */
+uint16_t chaos_member_lookup(uint16_t id);
+
+/**
+ * \brief            Fill the membership fields of the flooding data,
+ *                   before \link chaos_start \endlink.
+ * \param initiator_ Not zero if the node starts the round.
+ */
+void chaos_member_prepare(uint8_t initiator_);
+
+/**
+ * \brief            Update the members from the merged data,
+ *                   after \link chaos_stop \endlink.
+ */
+void chaos_member_round_end(uint8_t initiator_);
+
+/**
+ * \brief            Merge join requests and leaves.
+ *
+ *                   Called by Chaos while processing a received packet.
+ * \returns          Not zero if the received data has changed.
+ */
+uint8_t chaos_member_processing(chaos_data_struct *local, chaos_data_struct *received);
+
+/** @} */
+
+#endif /* CHAOS_MEMBER_H_ */
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Network-coded dissemination on top of Chaos, source file.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#include "chaos-nc.h"
+#include "lib/random.h"
+
+#if CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+
+#define NC_WORDS ((PAYLOAD_LEN + 1) / 2)
+
+// known blocks in row echelon form: row i, if present, has its lowest coefficient bit at i
+static uint16_t rows;                        // rows present
+static uint16_t row_coeffs[CHAOS_NC_BLOCKS];
+static uint16_t row_data[CHAOS_NC_BLOCKS][NC_WORDS];
+static uint8_t rank;
+// block to send: XOR of the rows in tx_rows
+static uint16_t tx_rows;
+static uint16_t tx_coeffs;
+static uint16_t tx_data[NC_WORDS];
+static uint8_t source;
+static unsigned long delivered_seq_no;
+static chaos_nc_deliver_t deliver_fn;
+
+PROCESS(chaos_nc_process, "Chaos network coding");
+PROCESS_THREAD(chaos_nc_process, ev, data)
+{
+	PROCESS_BEGIN();
+
+	while(1) {
+		PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+		if (deliver_fn) {
+			// decoded rows are the blocks of the object, in order
+			deliver_fn(delivered_seq_no, (const uint8_t *)row_data);
+		}
+	}
+
+	PROCESS_END();
+}
+
+static inline void xor_words(uint16_t *dst, const uint16_t *src) {
+	uint8_t i;
+	for (i = 0; i < NC_WORDS; i++) {
+		dst[i] ^= src[i];
+	}
+}
+
+static inline void tx_toggle(uint8_t r) {
+	tx_rows ^= 1u << r;
+	tx_coeffs ^= row_coeffs[r];
+	xor_words(tx_data, row_data[r]);
+}
+
+static inline int8_t reduce(uint16_t *coeffs, uint16_t *block) {
+	// eliminate the known pivots, lowest first; returns the new pivot, -1 if nothing new
+	uint8_t b;
+	for (b = 0; b < CHAOS_NC_BLOCKS; b++) {
+		if (!(*coeffs & (1u << b))) {
+			continue;
+		}
+		if (!(rows & (1u << b))) {
+			return b;
+		}
+		*coeffs ^= row_coeffs[b];
+		xor_words(block, row_data[b]);
+	}
+	return -1;
+}
+
+static inline void set_my_flag(chaos_data_struct *d) {
+	if (node_index / 8 < MERGE_LEN) {
+		d->flags[node_index / 8] |= 1 << (node_index % 8);
+	}
+}
+
+void chaos_nc_init(chaos_nc_deliver_t deliver) {
+	deliver_fn = deliver;
+	process_start(&chaos_nc_process, NULL);
+}
+
+void chaos_nc_prepare(const uint8_t *object) {
+	chaos_data_struct *d = CHAOS_DATA;
+	uint8_t i;
+	rows = tx_rows = tx_coeffs = 0;
+	rank = 0;
+	memset(tx_data, 0, sizeof(tx_data));
+	source = (object != NULL);
+	if (source) {
+		// the source knows every block: unit coefficients, and starts with the first one
+		for (i = 0; i < CHAOS_NC_BLOCKS; i++) {
+			memcpy(row_data[i], &object[i * PAYLOAD_LEN], PAYLOAD_LEN);
+			row_coeffs[i] = 1u << i;
+		}
+		rows = (uint16_t)((1uL << CHAOS_NC_BLOCKS) - 1);
+		rank = CHAOS_NC_BLOCKS;
+		tx_toggle(0);
+	} else if (node_index / 8 < MERGE_LEN) {
+		// the flag means the object is decoded
+		d->flags[node_index / 8] &= ~(1 << (node_index % 8));
+	}
+	d->nc_coeffs = tx_coeffs;
+	d->nc_rank = rank;
+	memcpy(d->payload, tx_data, PAYLOAD_LEN);
+	memset(d->chunks, 0, CHAOS_CHUNK_MAP_LEN);
+}
+
+uint8_t chaos_nc_processing(chaos_data_struct *local, chaos_data_struct *received) {
+	uint8_t tx_ = (rank > received->nc_rank);
+	uint16_t *block = (uint16_t *)received->payload;
+	int8_t pivot;
+	if (rank < CHAOS_NC_BLOCKS && received->nc_coeffs) {
+		pivot = reduce(&received->nc_coeffs, block);
+		if (pivot >= 0) {
+			// new to us: keep it, and send it along from now on
+			rows |= 1u << pivot;
+			row_coeffs[pivot] = received->nc_coeffs;
+			memcpy(row_data[pivot], block, PAYLOAD_LEN);
+			rank++;
+			tx_toggle(pivot);
+			tx_ = 1;
+			if (rank == CHAOS_NC_BLOCKS) {
+				set_my_flag(received);
+			}
+		}
+	}
+	if (rank > 1) {
+		// mix in another known block, so that consecutive transmissions differ
+		uint8_t r = random_rand() % CHAOS_NC_BLOCKS;
+		if ((rows & (1u << r)) && tx_rows != (1u << r)) {
+			tx_toggle(r);
+		}
+	}
+	// the received buffer becomes the packet we send
+	received->nc_coeffs = tx_coeffs;
+	received->nc_rank = rank;
+	memcpy(received->payload, tx_data, PAYLOAD_LEN);
+	return tx_;
+}
+
+void chaos_nc_round_end(void) {
+	int8_t b;
+	uint8_t c;
+	if (source || rank < CHAOS_NC_BLOCKS) {
+		return;
+	}
+	// back substitution, highest pivot first: row b ends up as block b
+	for (b = CHAOS_NC_BLOCKS - 1; b >= 0; b--) {
+		for (c = b + 1; c < CHAOS_NC_BLOCKS; c++) {
+			if (row_coeffs[b] & (1u << c)) {
+				row_coeffs[b] ^= row_coeffs[c];
+				xor_words(row_data[b], row_data[c]);
+			}
+		}
+	}
+	delivered_seq_no = CHAOS_DATA->seq_no;
+	process_poll(&chaos_nc_process);
+}
+
+#endif /* CHAOS_MERGE_OP */
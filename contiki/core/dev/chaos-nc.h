@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Network-coded dissemination on top of Chaos, header file.
+ *
+ *         The initiator disseminates an object of \link CHAOS_NC_BLOCKS \endlink
+ *         blocks within one round. Each packet carries one block coded as
+ *         the XOR of some blocks of the object (a linear combination over
+ *         GF(2)) and the bitmap of those blocks. Nodes reduce what they
+ *         receive against what they know (incremental Gaussian elimination)
+ *         and relay combinations of everything they know, so that a node
+ *         with only part of the object still sends useful data. A node sets
+ *         its flag once it can decode the whole object: the round completes
+ *         when everybody has it.
+ *
+ *         Used with \link CHAOS_MERGE_OP \endlink set to
+ *         \link CHAOS_MERGE_XOR \endlink.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#ifndef CHAOS_NC_H_
+#define CHAOS_NC_H_
+
+#include "chaos.h"
+#include "chaos-test.h"
+
+/**
+ * Length of the disseminated object.
+ */
+#define CHAOS_NC_OBJECT_LEN             (CHAOS_NC_BLOCKS * PAYLOAD_LEN)
+
+/**
+ * \brief            Get a decoded object, from process context.
+ *
+ *                   The object stays valid until the next
+ *                   \link chaos_nc_prepare \endlink.
+ */
+typedef void (*chaos_nc_deliver_t)(unsigned long seq_no, const uint8_t *object);
+
+/**
+ * \defgroup chaos_nc Interface related to network-coded dissemination
+ * @{
+ */
+
+/**
+ * \brief            Set up network-coded dissemination, on all nodes.
+ * \param deliver    Function called with each object decoded by a receiver.
+ */
+void chaos_nc_init(chaos_nc_deliver_t deliver);
+
+/**
+ * \brief            Prepare the coded fields of the flooding data,
+ *                   before \link chaos_start \endlink (after setting the flags).
+ * \param object     Object of \link CHAOS_NC_OBJECT_LEN \endlink bytes at
+ *                   the initiator, NULL at receivers.
+ */
+void chaos_nc_prepare(const uint8_t *object);
+
+/**
+ * \brief            Decode the object, after \link chaos_stop \endlink.
+ */
+void chaos_nc_round_end(void);
+
+/**
+ * \brief            Reduce the received block against the known ones and
+ *                   replace it with the next block to send.
+ *
+ *                   Called by Chaos while processing a received packet.
+ * \returns          Not zero if the node should transmit: the received block
+ *                   was new to it, or it knows more than the sender.
+ */
+uint8_t chaos_nc_processing(chaos_data_struct *local, chaos_data_struct *received);
+
+/** @} */
+
+#endif /* CHAOS_NC_H_ */
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Round scheduler for several periodic applications sharing Chaos,
+ *         source file.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#include "chaos-sched.h"
+
+#if CHAOS_SCHED
+
+static const chaos_sched_app *apps[CHAOS_SCHED_APPS];
+static uint8_t n_apps;
+static uint8_t pending;                      // released rounds not served yet
+static unsigned long release[CHAOS_SCHED_APPS]; // phase of the last release
+static uint8_t released;                     // release[] valid
+static uint8_t served;                       // applications of the last round
+static unsigned int missed;
+
+PROCESS(chaos_sched_process, "Chaos scheduler");
+PROCESS_THREAD(chaos_sched_process, ev, data)
+{
+	PROCESS_BEGIN();
+
+	while(1) {
+		PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+		uint8_t i;
+		for (i = 0; i < n_apps; i++) {
+			if ((served & (1 << i)) && apps[i]->done) {
+				apps[i]->done();
+			}
+		}
+	}
+
+	PROCESS_END();
+}
+
+int8_t chaos_sched_register(const chaos_sched_app *app) {
+	if (n_apps >= CHAOS_SCHED_APPS || !app->period || app->duration >= CHAOS_PERIOD ||
+			(app->merge_op != CHAOS_MERGE_NONE && app->merge_op != CHAOS_MERGE_OP)) {
+		return -1;
+	}
+	if (!n_apps) {
+		process_start(&chaos_sched_process, NULL);
+	}
+	apps[n_apps] = app;
+	return n_apps++;
+}
+
+uint8_t chaos_sched_next(unsigned long seq_no, rtimer_clock_t *duration) {
+	uint8_t i, edf = CHAOS_SCHED_APPS;
+	unsigned long deadline = 0;
+	for (i = 0; i < n_apps; i++) {
+		uint8_t bit = 1 << i;
+		unsigned long r = seq_no - seq_no % apps[i]->period;
+		if ((pending & bit) && seq_no >= release[i] + apps[i]->period) {
+			// deadline passed: drop the round
+			pending &= ~bit;
+			missed++;
+		}
+		if (!(released & bit) || r != release[i]) {
+			// a new round is due, even if earlier ones were skipped
+			release[i] = r;
+			released |= bit;
+			pending |= bit;
+		}
+		if ((pending & bit) && (edf == CHAOS_SCHED_APPS || release[i] + apps[i]->period < deadline)) {
+			// earliest deadline first, the lowest identifier on ties
+			edf = i;
+			deadline = release[i] + apps[i]->period;
+		}
+	}
+	*duration = CHAOS_DURATION;
+	if (edf == CHAOS_SCHED_APPS) {
+		// nothing due: the round only keeps the nodes synchronized
+		return 0;
+	}
+	// add the compatible rounds: a single payload user
+	uint8_t selected = 0;
+	uint8_t payload = (apps[edf]->merge_op != CHAOS_MERGE_NONE);
+	for (i = 0; i < n_apps; i++) {
+		if ((pending & (1 << i)) &&
+				(i == edf || apps[i]->merge_op == CHAOS_MERGE_NONE || !payload)) {
+			selected |= 1 << i;
+			payload |= (apps[i]->merge_op != CHAOS_MERGE_NONE);
+			if (apps[i]->duration > *duration) {
+				*duration = apps[i]->duration;
+			}
+		}
+	}
+	return selected;
+}
+
+void chaos_sched_prepare(uint8_t apps_, uint8_t initiator_) {
+	uint8_t i;
+	CHAOS_DATA->sched_apps = apps_;
+	for (i = 0; i < n_apps; i++) {
+		if ((apps_ & (1 << i)) && apps[i]->prepare) {
+			apps[i]->prepare(initiator_);
+		}
+	}
+}
+
+void chaos_sched_round_end(void) {
+	// what the initiator flooded is authoritative: it may differ from the local guess
+	served = get_rx_cnt() ? (CHAOS_DATA->sched_apps & ((1 << n_apps) - 1)) : 0;
+	if (served) {
+		pending &= ~served;
+		process_poll(&chaos_sched_process);
+	}
+}
+
+unsigned int chaos_sched_get_missed(void) {
+	return missed;
+}
+
+#endif /* CHAOS_SCHED */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Round scheduler for several periodic applications sharing Chaos,
+ *         header file.
+ *
+ *         Applications register a period (in Chaos periods), the length of
+ *         the Chaos phase they need and whether they use the payload.
+ *         Every Chaos phase the scheduler picks the released application
+ *         with the earliest deadline and adds every other released one that
+ *         is compatible with it, i.e., all applications leaving the payload
+ *         alone and at most one using it. All nodes derive the schedule from
+ *         the sequence number; the initiator floods the applications of the
+ *         round along with the data.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#ifndef CHAOS_SCHED_H_
+#define CHAOS_SCHED_H_
+
+#include "chaos.h"
+#include "chaos-test.h"
+
+/**
+ * Maximum number of applications, one bit each in the flooded data.
+ */
+#ifndef CHAOS_SCHED_APPS
+#define CHAOS_SCHED_APPS                4
+#endif
+
+#if CHAOS_SCHED_APPS > 8
+#error "CHAOS_SCHED_APPS: at most 8 applications"
+#endif
+
+/**
+ * An application sharing the Chaos phases.
+ */
+typedef struct {
+	uint16_t period;         /**< Period, in Chaos periods: one round is due every period. */
+	rtimer_clock_t duration; /**< Length of the Chaos phase the application needs. */
+	uint8_t merge_op;        /**< \link CHAOS_MERGE_NONE \endlink if it only uses the flags (and the
+	                              fields of the modules on top of Chaos), \link CHAOS_MERGE_OP \endlink
+	                              if it uses the payload. */
+	void (*prepare)(uint8_t initiator_); /**< Set the contribution of the node, before
+	                                          \link chaos_start \endlink; may be NULL. */
+	void (*done)(void);      /**< Get the merged data, from process context; may be NULL. */
+} chaos_sched_app;
+
+/**
+ * \defgroup chaos_sched Interface related to the round scheduler
+ * @{
+ */
+
+/**
+ * \brief            Register an application, on all nodes in the same order.
+ * \param app        The application, kept by reference.
+ * \returns          Identifier of the application, -1 if there are too many
+ *                   applications, or the phase or merge operator do not fit.
+ */
+int8_t chaos_sched_register(const chaos_sched_app *app);
+
+/**
+ * \brief            Release the rounds due at a Chaos phase and pick the
+ *                   applications taking part in it.
+ * \param seq_no     Sequence number of the phase.
+ * \param duration   Set to the length of the phase, at least \link CHAOS_DURATION \endlink.
+ * \returns          Bitmap of the applications, by identifier.
+ */
+uint8_t chaos_sched_next(unsigned long seq_no, rtimer_clock_t *duration);
+
+/**
+ * \brief            Let the applications of the round set their data,
+ *                   before \link chaos_start \endlink.
+ * \param apps       Bitmap returned by \link chaos_sched_next \endlink.
+ * \param initiator_ Not zero if the node starts the round.
+ */
+void chaos_sched_prepare(uint8_t apps, uint8_t initiator_);
+
+/**
+ * \brief            Hand the merged data to the applications of the round
+ *                   as flooded by the initiator, after \link chaos_stop \endlink.
+ */
+void chaos_sched_round_end(void);
+
+/**
+ * \brief            Get the number of rounds dropped at their deadline.
+ */
+unsigned int chaos_sched_get_missed(void);
+
+/** @} */
+
+#endif /* CHAOS_SCHED_H_ */
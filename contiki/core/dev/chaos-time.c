@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Network-wide global time on top of the Chaos synchronization,
+ *         source file.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#include "chaos-time.h"
+
+#if CHAOS_GLOBAL_TIME
+
+#ifndef CM_POS
+#define CM_POS              CM_1 // for gcc 4.6, as in chaos.c
+#endif
+
+#define CHAOS_TIME_PERIOD_H ((uint32_t)CHAOS_PERIOD * CLOCK_PHI) // global time of a period
+
+static rtimer_clock_t ref_l;  // low-frequency tick preceding the reference time
+static rtimer_clock_t ref_h;  // DCO ticks from ref_l to the reference time
+static uint32_t ref_global;   // global time of the reference time
+static int32_t skew;          // local clock skew over a period, in 1/256 ticks
+static uint8_t valid;
+
+// written from the rtimer interrupt: readers take a consistent copy
+#define TIME_REF_GET(l, h, g, q) do { \
+		int s_ = splhigh(); \
+		(l) = ref_l; (h) = ref_h; (g) = ref_global; (q) = skew; \
+		splx(s_); \
+	} while (0)
+
+void chaos_time_update(unsigned long seq_no, int32_t skew_q) {
+	// predicted reference times keep the sub-tick offset of the last computed one
+	ref_l = get_t_ref_l();
+	ref_h = get_T_offset_h() + 1;
+	ref_global = (uint32_t)seq_no * CHAOS_TIME_PERIOD_H;
+	skew = skew_q;
+	valid = 1;
+}
+
+uint8_t chaos_time_valid(void) {
+	return valid;
+}
+
+uint32_t chaos_global_time(void) {
+	rtimer_clock_t t_now_h = RTIMER_NOW_DCO();
+#if COOJA
+	rtimer_clock_t t_cap_l = RTIMER_NOW();
+	rtimer_clock_t t_cap_h = RTIMER_NOW_DCO();
+#else
+	// capture the next low-frequency clock tick
+	rtimer_clock_t t_cap_h, t_cap_l;
+	CAPTURE_NEXT_CLOCK_TICK(t_cap_h, t_cap_l);
+#endif /* COOJA */
+	return chaos_global_timestamp(t_cap_l, -(int)(rtimer_clock_t)(t_cap_h - t_now_h));
+}
+
+uint32_t chaos_global_timestamp(rtimer_clock_t t_l, int t_h) {
+	rtimer_clock_t r_l, r_h;
+	uint32_t r_global;
+	int32_t q, local;
+	TIME_REF_GET(r_l, r_h, r_global, q);
+	// local DCO ticks since the reference time
+	local = (int32_t)(rtimer_clock_t)(t_l - r_l) * CLOCK_PHI + t_h - r_h;
+	// the local clock runs (CHAOS_PERIOD + skew) / CHAOS_PERIOD times as fast as the initiator's
+	return r_global + local - (local >> 8) * q / (int32_t)CHAOS_PERIOD;
+}
+
+rtimer_clock_t chaos_global_to_local(uint32_t global, rtimer_clock_t *t_h) {
+	rtimer_clock_t r_l, r_h;
+	uint32_t r_global, local;
+	int32_t q, elapsed;
+	TIME_REF_GET(r_l, r_h, r_global, q);
+	elapsed = (int32_t)(global - r_global);
+	local = elapsed + (elapsed >> 8) * q / (int32_t)CHAOS_PERIOD + r_h;
+	*t_h = local % CLOCK_PHI;
+	return r_l + (rtimer_clock_t)(local / CLOCK_PHI);
+}
+
+#endif /* CHAOS_GLOBAL_TIME */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2013, Olaf Landsiedel.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Author: Olaf Landsiedel <olafl@chalmers.se>
+ *
+ */
+
+/**
+ * \file
+ *         Network-wide global time on top of the Chaos synchronization,
+ *         header file.
+ *
+ *         The global time counts DCO ticks of the initiator: round n starts
+ *         at global time n * CHAOS_PERIOD * CLOCK_PHI, wrapping around at
+ *         32 bits (after about 17 minutes at 4 MHz; compare times by their
+ *         signed difference). Every other node converts its local clocks
+ *         from the reference time and sub-tick offset Chaos computed in the
+ *         last round, corrected by its estimated clock skew over a period.
+ *         Local times are given as a low-frequency time plus DCO ticks,
+ *         within 2^16 low-frequency ticks after the last reference time.
+ * \author
+ *         Olaf Landsiedel <olafl@chalmers.se>
+ */
+
+#ifndef CHAOS_TIME_H_
+#define CHAOS_TIME_H_
+
+#include "chaos.h"
+#include "chaos-test.h"
+
+/**
+ * \defgroup chaos_time Interface related to the global time
+ * @{
+ */
+
+/**
+ * \brief            Take the reference time of the last round, after its
+ *                   reference time was computed (or predicted, if missed)
+ *                   and the clock skew estimated.
+ * \param seq_no     Sequence number of the round.
+ * \param skew_q     Clock skew over a period of length \link CHAOS_PERIOD \endlink,
+ *                   in 1/256 low-frequency ticks (zero at the initiator).
+ */
+void chaos_time_update(unsigned long seq_no, int32_t skew_q);
+
+/**
+ * \brief            Check whether the global time is available.
+ * \returns          Not zero once \link chaos_time_update \endlink was called.
+ */
+uint8_t chaos_time_valid(void);
+
+/**
+ * \brief            Get the current global time, between rounds.
+ *
+ *                   Busy-waits for the next low-frequency clock tick
+ *                   (at most 1 / RTIMER_SECOND).
+ * \returns          Global time, in DCO ticks.
+ */
+uint32_t chaos_global_time(void);
+
+/**
+ * \brief            Convert a local timestamp to global time.
+ * \param t_l        Low-frequency time of the event (e.g., RTIMER_NOW()).
+ * \param t_h        DCO ticks from t_l to the event, may be negative.
+ * \returns          Global time, in DCO ticks.
+ */
+uint32_t chaos_global_timestamp(rtimer_clock_t t_l, int t_h);
+
+/**
+ * \brief            Convert a global time to local time, e.g., to sample at
+ *                   the same time on all nodes: set an rtimer at the returned
+ *                   time, then wait for t_h on the DCO.
+ * \param global     Global time, in DCO ticks, within 2^16 low-frequency
+ *                   ticks after the last reference time.
+ * \param t_h        Set to the DCO ticks from the returned time to the global time.
+ * \returns          Low-frequency time.
+ */
+rtimer_clock_t chaos_global_to_local(uint32_t global, rtimer_clock_t *t_h);
+
+/** @} */
+
+#endif /* CHAOS_TIME_H_ */
@@ -43,6 +43,10 @@
 
 #include "chaos.h"
 #include "chaos-test.h"
+#include "chaos-agree.h"
+#include "chaos-abcast.h"
+#include "chaos-member.h"
+#include "chaos-nc.h"
 
 /**
  * \brief a bunch of define for gcc 4.6
@@ -51,8 +55,24 @@
 #define CM_NEG              CM_2
 #define CM_BOTH             CM_3
 
+/**
+ * \brief PACKET_LEN depends on sizeof(chaos_data_struct), which #if cannot test:
+ *        a negative array size stops the build if the packet exceeds the 127-byte
+ *        frame of the CC2420 (e.g., reduce PAYLOAD_LEN when enabling CHAOS_FEC).
+ */
+typedef char chaos_packet_len_check[(PACKET_LEN <= 127) ? 1 : -1];
+
 static uint8_t initiator, /*sync,*/ rx_cnt, tx_cnt, tx_max;
-static uint8_t *data, *packet;
+/**
+ * Packet buffers: one holds the local data (the packet we transmit), the other
+ * one receives the next packet. After a successful merge the received packet
+ * becomes the local one, so neither the application data nor the packet is ever copied.
+ */
+// padding that keeps the data word aligned after an odd-length header
+#define CHAOS_BUFFER_PAD    (CHAOS_DATA_OFFSET & 1)
+static uint8_t chaos_buffers[2][CHAOS_BUFFER_PAD + PACKET_LEN + 1] __attribute__((aligned(2)));
+static uint8_t *data = &chaos_buffers[0][CHAOS_BUFFER_PAD + CHAOS_DATA_OFFSET];
+static uint8_t *packet = &chaos_buffers[0][CHAOS_BUFFER_PAD];
 //static uint8_t data_len, packet_len;
 static uint8_t bytes_read, tx_relay_cnt_last;
 static volatile uint8_t state;
@@ -64,18 +84,87 @@ static uint8_t tx;
 static uint8_t chaos_complete;
 static uint8_t tx_cnt_complete;
 static uint8_t estimate_length;
+static uint8_t stopped;
+static void (*off_hook)(void);
+#if CHAOS_BURST > 1
+static void (*burst_hook)(uint8_t round, uint8_t *data);
+static uint8_t burst_round, burst_tx;
+#endif /* CHAOS_BURST */
+#if CHAOS_HEADER_VERSION && CHAOS_BURST > 1
+// the round id of the burst travels in the header
+#define CHAOS_SET_HEADER(h)   (CHAOS_HEADER_FIELD = (h) | burst_round)
+#else
+#define CHAOS_SET_HEADER(h)   (CHAOS_HEADER_FIELD = (h))
+#endif /* CHAOS_HEADER_VERSION && CHAOS_BURST */
 static rtimer_clock_t t_timeout_start, t_timeout_stop, now, tbccr1;
 static uint32_t T_timeout_h;
 static uint16_t n_timeout_wait;
 static uint8_t n_slots_timeout, relay_cnt_timeout;
 
-static rtimer_clock_t T_slot_h = 0, T_rx_h, T_w_rt_h, T_tx_h, T_w_tr_h, t_ref_l, T_offset_h, t_first_rx_l;
-#if CHAOS_SYNC_WINDOW
-static unsigned long T_slot_h_sum;
-static uint8_t win_cnt;
-#endif /* CHAOS_SYNC_WINDOW */
+static rtimer_clock_t T_slot_h = 0, T_rx_h, T_w_rt_h, T_tx_h, T_w_tr_h, t_ref_l, T_offset_h, t_first_rx_l, t_complete_l;
+// slot length filter: running median of the last observations, then a Kalman gain
+#define CHAOS_SLOT_Q                  8 // fractional bits of the filtered slot length
+static uint32_t T_slot_q;
+static uint16_t slot_obs[CHAOS_SLOT_MEDIAN];
+static uint8_t slot_obs_cnt, slot_obs_next, slot_n, slot_rejects;
+#if CHAOS_SLOT_MEDIAN > 7 || !(CHAOS_SLOT_MEDIAN % 2)
+#error "CHAOS_SLOT_MEDIAN: an odd number of observations, at most 7"
+#endif
+#if CHAOS_SYNC_WINDOW < 1
+#error "CHAOS_SYNC_WINDOW: at least 1 (no smoothing)"
+#endif
 static uint8_t relay_cnt, t_ref_l_updated;
 
+#define CHAOS_PAYLOAD_OFFSET (CHAOS_DATA_OFFSET + offsetof(chaos_data_struct, payload))
+#define CHUNK_IS_SET(map, c) ((map)[(c) / 8] & (1 << ((c) % 8)))
+
+#if CHAOS_TXFIFO_PATCH
+static uint8_t txfifo_loaded, dirty_first, dirty_last;
+static uint8_t dirty_chunks[CHAOS_CHUNK_MAP_LEN];
+#endif /* CHAOS_TXFIFO_PATCH */
+
+#if CHAOS_HEADER_VERSION > 6
+#error "header versions go from 1 to 6, 7 is the legacy header"
+#endif
+#if CHAOS_HEADER_VERSION && CHAOS_BURST > CHAOS_HEADER_ROUND_MASK + 1
+#error "the versioned header has room for 8 rounds per burst"
+#endif
+
+#if !CHAOS_SYNC_MODE
+#if CHAOS_HOP_RELAYS || CHAOS_BURST > 1
+#error "hopping within a round and bursts need the relay counter of CHAOS_SYNC mode"
+#endif
+/**
+ * Fixed slot length without synchronization, to schedule timeouts: a packet
+ * (with preamble and SFD) at 32 us per byte, the processing time and the
+ * 12-symbol Rx/Tx turnaround.
+ */
+#define CHAOS_NO_SYNC_T_SLOT_H ((rtimer_clock_t)((PACKET_LEN + 6) * 32uL * (F_CPU / 1000000uL) + \
+		PROCESSING_CYCLES + 192uL * (F_CPU / 1000000uL)))
+#endif /* CHAOS_SYNC_MODE */
+
+#if CHAOS_FEC
+static uint8_t fec_repaired;    // last packet failed the hardware CRC but was repaired
+static uint8_t fec_rx_cnt;      // repaired receptions: not relayed right away, not timed
+#define CHAOS_RX_REPAIRED()   (fec_repaired)
+#define CHAOS_RX_CNT()        (rx_cnt + fec_rx_cnt)
+#define FEC_MIN(a, b)         (((a) < (b)) ? (a) : (b))
+#else
+#define CHAOS_RX_REPAIRED()   0
+#define CHAOS_RX_CNT()        rx_cnt
+#endif /* CHAOS_FEC */
+#define CHAOS_RX_OK()         ((CHAOS_CRC_FIELD & FOOTER1_CRC_OK) || CHAOS_RX_REPAIRED())
+
+#if CHAOS_HOPPING
+static const uint8_t hop_channels[] = CHAOS_HOP_CHANNELS;
+#define CHAOS_HOP_N                   sizeof(hop_channels)
+static unsigned long hop_seq_no;
+static uint8_t hop_idx;
+#endif /* CHAOS_HOPPING */
+static uint8_t channel = RF_CHANNEL; // without hopping
+static uint8_t tx_power = CC2420_TXPOWER, tx_power_set = CC2420_TXPOWER; // PA_LEVEL requested, and in TXCTRL
+static uint8_t crc_err_cnt; // receptions with a bad CRC during this phase
+
 #ifdef LOG_TIRQ
 #define CHAOS_TIRQ_LOG_SIZE 70
 static uint8_t tirq_log_cnt;
@@ -123,6 +212,18 @@ static inline void chaos_stop_timeout(void) {
 	UNSET_PIN_ADC6;
 }
 
+/* --------------------------- Packet buffers ----------------------- */
+static inline void packet_use_local(void) {
+	// point to the buffer holding the local data again
+	packet = data - CHAOS_DATA_OFFSET;
+}
+
+static inline void packet_use_rx(void) {
+	// receive into the buffer not holding the local data
+	packet = (packet == &chaos_buffers[0][CHAOS_BUFFER_PAD]) ?
+			&chaos_buffers[1][CHAOS_BUFFER_PAD] : &chaos_buffers[0][CHAOS_BUFFER_PAD];
+}
+
 /* --------------------------- Radio functions ---------------------- */
 static inline void radio_flush_tx(void) {
 	FASTSPI_STROBE(CC2420_SFLUSHTX);
@@ -168,6 +269,7 @@ static inline void radio_abort_rx(void) {
 	state = CHAOS_STATE_ABORTED;
 	UNSET_PIN_ADC1;
 	radio_flush_rx();
+	packet_use_local();
 }
 
 static inline void radio_abort_tx(void) {
@@ -194,13 +296,583 @@ static inline void radio_start_tx(void) {
 	chaos_schedule_timeout();
 }
 
+#if CHAOS_TXFIFO_PATCH
+static inline void chaos_dirty_clear(void) {
+	// the TXFIFO matches the local data
+	dirty_first = dirty_last = 0;
+	memset(dirty_chunks, 0, CHAOS_CHUNK_MAP_LEN);
+}
+
+static inline void chaos_dirty_chunks(chaos_data_struct* local, chaos_data_struct* received,
+		uint8_t first, uint8_t last) {
+	// mark the chunks from first to last that the merge changed
+	uint8_t c, off, len;
+	for (c = first; c <= last; c++) {
+		off = c * CHAOS_CHUNK_LEN;
+		len = (c == CHAOS_CHUNKS - 1) ? PAYLOAD_LEN - off : CHAOS_CHUNK_LEN;
+		if (memcmp(&received->payload[off], &local->payload[off], len)) {
+			dirty_chunks[c / 8] |= 1 << (c % 8);
+		}
+	}
+}
+#endif /* CHAOS_TXFIFO_PATCH */
+
 static inline void radio_write_tx(void) {
 	FASTSPI_WRITE_FIFO(packet, PACKET_LEN - 1);
+#if CHAOS_TXFIFO_PATCH
+	txfifo_loaded = 1;
+	chaos_dirty_clear();
+#endif /* CHAOS_TXFIFO_PATCH */
+}
+
+#if CHAOS_TXFIFO_PATCH
+static inline void radio_patch_tx(void) {
+	uint8_t n;
+	// the TXFIFO is never flushed after a transmission and still holds the local packet:
+	// overwrite in its RAM only what changed, in the order the transmitter reads it
+	FASTSPI_WRITE_RAM_LE(&CHAOS_HEADER_FIELD, (CC2420RAM_TXFIFO + 1), 1, n);
+	if (dirty_last > dirty_first) {
+		FASTSPI_WRITE_RAM_LE(&packet[CHAOS_DATA_OFFSET + dirty_first],
+				(CC2420RAM_TXFIFO + CHAOS_DATA_OFFSET + dirty_first), dirty_last - dirty_first, n);
+	}
+	// payload: one write per run of dirty chunks
+	uint8_t c = 0, first, start, end;
+	while (c < CHAOS_CHUNKS) {
+		if (!CHUNK_IS_SET(dirty_chunks, c)) {
+			c++;
+			continue;
+		}
+		first = c;
+		while (c < CHAOS_CHUNKS && CHUNK_IS_SET(dirty_chunks, c)) {
+			c++;
+		}
+		start = CHAOS_PAYLOAD_OFFSET + first * CHAOS_CHUNK_LEN;
+		end = (c == CHAOS_CHUNKS) ? CHAOS_PAYLOAD_OFFSET + PAYLOAD_LEN : CHAOS_PAYLOAD_OFFSET + c * CHAOS_CHUNK_LEN;
+		FASTSPI_WRITE_RAM_LE(&packet[start], (CC2420RAM_TXFIFO + start), end - start, n);
+	}
+#if CHAOS_FEC
+	FASTSPI_WRITE_RAM_LE(&CHAOS_FEC_FIELD, (CC2420RAM_TXFIFO + CHAOS_DATA_OFFSET + CHAOS_FEC_COVERED),
+			CHAOS_FEC_LEN, n);
+#endif /* CHAOS_FEC */
+#if CHAOS_FLAGS_CRC
+	FASTSPI_WRITE_RAM_LE(&CHAOS_FLAGS_CRC_FIELD, (CC2420RAM_TXFIFO + CHAOS_DATA_OFFSET + CHAOS_FLAGS_CRC_OFFSET),
+			CHAOS_FLAGS_CRC_LEN, n);
+#endif /* CHAOS_FLAGS_CRC */
+	if (CHAOS_SYNC_MODE) {
+		FASTSPI_WRITE_RAM_LE(&CHAOS_RELAY_CNT_FIELD, (CC2420RAM_TXFIFO + PACKET_LEN - FOOTER_LEN), 1, n);
+	}
+	chaos_dirty_clear();
+}
+
+static inline void chaos_dirty_range(void) {
+	// bytes of the merged packet that differ from the local data (and the TXFIFO):
+	// a range for sequence number, flags and chunk bitmap...
+	uint8_t *merged = &CHAOS_DATA_FIELD;
+	uint8_t i;
+	dirty_first = offsetof(chaos_data_struct, payload);
+	dirty_last = 0;
+	for (i = 0; i < offsetof(chaos_data_struct, payload); i++) {
+		if (merged[i] != data[i]) {
+			dirty_first = i;
+			break;
+		}
+	}
+	for (i = offsetof(chaos_data_struct, payload); i > dirty_first; i--) {
+		if (merged[i - 1] != data[i - 1]) {
+			dirty_last = i;
+			break;
+		}
+	}
+#if CHAOS_MERGE_OP == CHAOS_MERGE_NONE
+	// ...and the payload chunks, unless the merge operator already marked them
+	chaos_dirty_chunks((chaos_data_struct*)data, (chaos_data_struct*)merged, 0, CHAOS_CHUNKS - 1);
+#endif /* CHAOS_MERGE_OP */
+}
+#endif /* CHAOS_TXFIFO_PATCH */
+
+static inline void radio_update_tx(void) {
+#if CHAOS_TXFIFO_PATCH
+	if (txfifo_loaded) {
+		radio_patch_tx();
+		return;
+	}
+#endif /* CHAOS_TXFIFO_PATCH */
+	radio_write_tx();
+}
+
+#if CHAOS_HOPPING
+static inline void radio_set_channel(uint8_t hop) {
+	// consecutive rounds start on consecutive entries of the hopping list
+	FASTSPI_SETREG(CC2420_FSCTRL, CC2420_FSCTRL_CHANNEL(hop_channels[(hop_seq_no + hop) % CHAOS_HOP_N]));
+}
+
+#if CHAOS_HOP_RELAYS
+/**
+ * Switch to the channel used by transmissions with relay counter relay_cnt_next.
+ * Returns not zero if the channel changed: the caller has to issue SRXON or STXON
+ * to make the radio calibrate to the new frequency.
+ */
+static inline uint8_t chaos_hop(uint8_t relay_cnt_next) {
+	uint8_t hop = relay_cnt_next / CHAOS_HOP_RELAYS;
+	if (hop == hop_idx) {
+		return 0;
+	}
+	hop_idx = hop;
+	radio_set_channel(hop);
+	return 1;
+}
+#endif /* CHAOS_HOP_RELAYS */
+#endif /* CHAOS_HOPPING */
+
+/*
+ * Worst-case DCO cycles of everything chaos_data_processing and the checks run within
+ * PROCESSING_CYCLES. These are estimates from counting instructions for mspgcc -Os,
+ * not measurements: keep a margin, and measure (T_irq in the debug output) before
+ * trimming PROCESSING_CYCLES.
+ * - flags: about 20 cycles per flag byte, plus about 20 to take over a higher sequence number;
+ * - payload: 40 cycles per chunk and, for chunked operators, 12 (OR) or 16 (MAX) cycles per
+ *   byte merged plus 8 per byte compared for the TXFIFO patch. Top-k merges two sorted lists in
+ *   about 60 cycles per output entry plus a copy and a compare. Network coding XORs up to two
+ *   rows per block plus the reduction, about 6 cycles per word each, then copies and compares
+ *   the payload. Sections cost a dispatch and check (as much as a chunk at most) and the per-byte
+ *   cost of their operator, plus about 10 cycles per byte of full bitmaps for completion;
+ * - TXFIFO patch: 8 cycles per byte of the data before the payload compared for the dirty range;
+ * - FEC: a table-driven CRC-16 and the parity, about 24 cycles per byte of flags and payload,
+ *   twice for a repaired packet; the flags CRC about 24 cycles per byte of sequence number and flags;
+ * - agreement: about 20 cycles per vote byte, plus the vote callback (kept under 100 cycles);
+ * - atomic broadcast: about 20 cycles per byte of both slot maps, plus 8 per message byte copied;
+ * - membership: about 20 cycles per byte of the leave bitmap, plus the join request.
+ * - bursts: the hook moving to the next logical round, CHAOS_BURST_HOOK_CYCLES.
+ */
+#if CHAOS_FEC
+#define CHAOS_FEC_CYCLES             ((MERGE_LEN + PAYLOAD_LEN) * 24 * 2)
+#else
+#define CHAOS_FEC_CYCLES             0
+#endif /* CHAOS_FEC */
+#if CHAOS_FLAGS_CRC
+#define CHAOS_FLAGS_CRC_CYCLES       ((4 + MERGE_LEN) * 24) // 4-byte sequence number
+#else
+#define CHAOS_FLAGS_CRC_CYCLES       0
+#endif /* CHAOS_FLAGS_CRC */
+#if CHAOS_TXFIFO_PATCH
+#define CHAOS_PATCH_CYCLES           (offsetof(chaos_data_struct, payload) * 8)
+#else
+#define CHAOS_PATCH_CYCLES           0
+#endif /* CHAOS_TXFIFO_PATCH */
+#if CHAOS_AGREE
+#define CHAOS_AGREE_CYCLES           (MERGE_LEN * 20 + 100)
+#else
+#define CHAOS_AGREE_CYCLES           0
+#endif /* CHAOS_AGREE */
+#if CHAOS_ABCAST
+#define CHAOS_ABCAST_CYCLES          (2 * MERGE_LEN * 20 + 2 * CHAOS_NODES * CHAOS_ABCAST_MSG_LEN * 8)
+#else
+#define CHAOS_ABCAST_CYCLES          0
+#endif /* CHAOS_ABCAST */
+#if CHAOS_MEMBERSHIP
+#define CHAOS_MEMBER_CYCLES          (MERGE_LEN * 20 + 40)
+#else
+#define CHAOS_MEMBER_CYCLES          0
+#endif /* CHAOS_MEMBERSHIP */
+#if CHAOS_BURST > 1
+#define CHAOS_BURST_CYCLES           CHAOS_BURST_HOOK_CYCLES
+#else
+#define CHAOS_BURST_CYCLES           0
+#endif /* CHAOS_BURST */
+#define CHAOS_FLAGS_CYCLES           (MERGE_LEN * 20 + 20 + CHAOS_FEC_CYCLES + CHAOS_FLAGS_CRC_CYCLES + \
+		CHAOS_PATCH_CYCLES + CHAOS_AGREE_CYCLES + CHAOS_ABCAST_CYCLES + CHAOS_MEMBER_CYCLES + CHAOS_BURST_CYCLES)
+#if CHAOS_MERGE_OP == CHAOS_MERGE_NONE
+#define CHAOS_MERGE_CYCLES           (CHAOS_TXFIFO_PATCH ? PAYLOAD_LEN * 8 : 0)
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_OR || CHAOS_MERGE_OP == CHAOS_MERGE_HIST
+#define CHAOS_MERGE_CYCLES           (CHAOS_CHUNKS * 40 + PAYLOAD_LEN * (12 + 8))
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_MAX
+#define CHAOS_MERGE_CYCLES           (CHAOS_CHUNKS * 40 + PAYLOAD_LEN * (16 + 8))
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_TOPK
+#define CHAOS_MERGE_CYCLES           (CHAOS_CHUNKS * 40 + CHAOS_TOPK_K * (60 + 4 * (6 + 8)))
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+#define CHAOS_MERGE_CYCLES           ((CHAOS_NC_BLOCKS + 2) * PAYLOAD_LEN * 3 + PAYLOAD_LEN * (4 + 8))
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+#define CHAOS_MERGE_CYCLES           (CHAOS_CHUNKS * 40 + PAYLOAD_LEN * (16 + 8 + 10))
+#endif /* CHAOS_MERGE_OP */
+// flags and payload processing must fit in PROCESSING_CYCLES (offsetof rules out #if)
+typedef char chaos_processing_cycles_check[(CHAOS_FLAGS_CYCLES + CHAOS_MERGE_CYCLES <= PROCESSING_CYCLES) ? 1 : -1];
+
+#if CHAOS_MERGE_OP == CHAOS_MERGE_TOPK
+static inline uint8_t topk_before(chaos_topk_entry *a, chaos_topk_entry *b) {
+	// unused entries have value zero and the highest node index: they sort last
+	return (a->value > b->value) || (a->value == b->value && a->node < b->node);
+}
+
+static inline uint8_t merge_topk(chaos_topk_entry *received, chaos_topk_entry *local) {
+	// merge two sorted lists: a node reports the same value to everybody,
+	// so its entries meet at the heads of both lists
+	chaos_topk_entry merged[CHAOS_TOPK_K];
+	chaos_topk_entry *next;
+	uint8_t r = 0, l = 0, m = 0;
+	while (m < CHAOS_TOPK_K && (r < CHAOS_TOPK_K || l < CHAOS_TOPK_K)) {
+		if (r == CHAOS_TOPK_K) {
+			next = &local[l++];
+		} else if (l == CHAOS_TOPK_K) {
+			next = &received[r++];
+		} else if (received[r].node == local[l].node) {
+			next = &received[r++];
+			l++;
+		} else if (topk_before(&local[l], &received[r])) {
+			next = &local[l++];
+		} else {
+			next = &received[r++];
+		}
+		if (next->node == CHAOS_TOPK_NONE) {
+			// only unused entries left
+			break;
+		}
+		merged[m++] = *next;
+	}
+	for (; m < CHAOS_TOPK_K; m++) {
+		merged[m].value = 0;
+		merged[m].node = CHAOS_TOPK_NONE;
+	}
+	if (!memcmp(received, merged, sizeof(merged))) {
+		return 0;
+	}
+	memcpy(received, merged, sizeof(merged));
+	return 1;
+}
+
+static inline void chaos_payload_processing(chaos_data_struct* local, chaos_data_struct* received) {
+	// the list is one unit starting at chunk zero
+	chaos_topk_entry *rx_list = (chaos_topk_entry *)received->payload;
+	chaos_topk_entry *local_list = (chaos_topk_entry *)local->payload;
+	uint8_t changed;
+	if (!(local->chunks[0] & 1)) {
+		// nothing from us: the received list is the merged one
+		changed = received->chunks[0] & 1;
+	} else if (!(received->chunks[0] & 1)) {
+		// only we have a list: take ours, the TXFIFO already has it
+		memcpy(rx_list, local_list, CHAOS_TOPK_K * sizeof(chaos_topk_entry));
+		memcpy(received->chunks, local->chunks, CHAOS_CHUNK_MAP_LEN);
+		tx = 1;
+		changed = 0;
+	} else {
+		tx |= merge_topk(rx_list, local_list);
+		changed = memcmp(rx_list, local_list, CHAOS_TOPK_K * sizeof(chaos_topk_entry)) != 0;
+	}
+#if CHAOS_TXFIFO_PATCH
+	if (changed) {
+		chaos_dirty_chunks(local, received, 0, (CHAOS_TOPK_K * sizeof(chaos_topk_entry) - 1) / CHAOS_CHUNK_LEN);
+	}
+#endif /* CHAOS_TXFIFO_PATCH */
+}
+
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_XOR
+static inline void chaos_payload_processing(chaos_data_struct* local, chaos_data_struct* received) {
+	// the payload is one coded block
+	tx |= chaos_nc_processing(local, received);
+#if CHAOS_TXFIFO_PATCH
+	chaos_dirty_chunks(local, received, 0, CHAOS_CHUNKS - 1);
+#endif /* CHAOS_TXFIFO_PATCH */
+}
+
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+/*
+ * Sections of the payload with their own operator: the operators are dispatched
+ * through a table, one indirect call per section.
+ */
+typedef uint8_t (*mux_merge_t)(uint8_t *received, uint8_t *local, uint8_t len);
+
+static uint8_t mux_merge_none(uint8_t *received, uint8_t *local, uint8_t len) {
+	// the received section replaces the local one
+	return 0;
+}
+
+static uint8_t mux_merge_or(uint8_t *received, uint8_t *local, uint8_t len) {
+	uint8_t changed = 0;
+	while (len--) {
+		changed |= (*local & ~*received);
+		*received++ |= *local++;
+	}
+	return changed;
+}
+
+static uint8_t mux_merge_max(uint8_t *received, uint8_t *local, uint8_t len) {
+	uint8_t changed = 0;
+	for (; len; len--, received++, local++) {
+		if (*local > *received) {
+			*received = *local;
+			changed = 1;
+		}
+	}
+	return changed;
+}
+
+static const mux_merge_t mux_merge[] = {
+	[CHAOS_MERGE_NONE] = mux_merge_none,
+	[CHAOS_MERGE_OR] = mux_merge_or,
+	[CHAOS_MERGE_MAX] = mux_merge_max,
+};
+const chaos_mux_section chaos_mux_sections[] = CHAOS_MUX_SECTIONS;
+#define CHAOS_MUX_N (sizeof(chaos_mux_sections) / sizeof(chaos_mux_sections[0]))
+const uint8_t chaos_mux_sections_n = CHAOS_MUX_N;
+
+static inline void chaos_payload_processing(chaos_data_struct* local, chaos_data_struct* received) {
+	const chaos_mux_section *sec;
+	for (sec = chaos_mux_sections; sec < chaos_mux_sections + CHAOS_MUX_N; sec++) {
+		if (!CHAOS_MUX_SECTION_OK(sec)) {
+			// never index the table (or the payload) with a bad section
+			continue;
+		}
+		tx |= mux_merge[sec->op](&received->payload[sec->offset], &local->payload[sec->offset], sec->len);
+#if CHAOS_TXFIFO_PATCH
+		// rewrite the chunks of the section that changed
+		chaos_dirty_chunks(local, received, sec->offset / CHAOS_CHUNK_LEN,
+				(sec->offset + sec->len - 1) / CHAOS_CHUNK_LEN);
+#endif /* CHAOS_TXFIFO_PATCH */
+	}
+}
+
+static inline uint8_t chaos_mux_done(chaos_data_struct* d) {
+	// not zero if the sections do not hold back completion
+	const chaos_mux_section *sec;
+	uint8_t i;
+	for (sec = chaos_mux_sections; sec < chaos_mux_sections + CHAOS_MUX_N; sec++) {
+		if (sec->done == CHAOS_MUX_DONE_FULL && CHAOS_MUX_SECTION_OK(sec)) {
+			for (i = 0; i < MERGE_LEN - 1; i++) {
+				if (d->payload[sec->offset + i] != 0xFF) {
+					return 0;
+				}
+			}
+			if ((d->payload[sec->offset + MERGE_LEN - 1] & CHAOS_COMPLETE_FLAG) != CHAOS_COMPLETE_FLAG) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+#elif CHAOS_MERGE_OP != CHAOS_MERGE_NONE
+static inline uint8_t merge_chunk(uint8_t *received, uint8_t *local, uint8_t len) {
+	// merge the local chunk into the received one, return not zero if the latter changed
+	uint8_t changed = 0;
+	uint8_t i;
+	for (i = 0; i < len; i++) {
+#if CHAOS_MERGE_OP == CHAOS_MERGE_OR || CHAOS_MERGE_OP == CHAOS_MERGE_HIST
+		changed |= (local[i] & ~received[i]);
+		received[i] |= local[i];
+#elif CHAOS_MERGE_OP == CHAOS_MERGE_MAX
+		if (local[i] > received[i]) {
+			received[i] = local[i];
+			changed = 1;
+		}
+#else
+#error "unknown merge operator"
+#endif
+	}
+	return changed;
+}
+
+static inline void chaos_payload_processing(chaos_data_struct* local, chaos_data_struct* received) {
+	uint8_t c, off, len, bit;
+	for (c = 0; c < CHAOS_CHUNKS; c++) {
+		bit = 1 << (c % 8);
+		off = c * CHAOS_CHUNK_LEN;
+		len = (c == CHAOS_CHUNKS - 1) ? PAYLOAD_LEN - off : CHAOS_CHUNK_LEN;
+		if (!(local->chunks[c / 8] & bit)) {
+			// nothing from us in this chunk: the received one is the merged one
+#if CHAOS_TXFIFO_PATCH
+			if (received->chunks[c / 8] & bit) {
+				chaos_dirty_chunks(local, received, c, c);
+			}
+#endif /* CHAOS_TXFIFO_PATCH */
+			continue;
+		}
+		if (!(received->chunks[c / 8] & bit)) {
+			// only we have data in this chunk: take ours, the TXFIFO already has it
+			memcpy(&received->payload[off], &local->payload[off], len);
+			received->chunks[c / 8] |= bit;
+			tx = 1;
+			continue;
+		}
+		tx |= merge_chunk(&received->payload[off], &local->payload[off], len);
+#if CHAOS_TXFIFO_PATCH
+		chaos_dirty_chunks(local, received, c, c);
+#endif /* CHAOS_TXFIFO_PATCH */
+	}
+}
+#endif /* CHAOS_MERGE_OP */
+
+#if CHAOS_FEC || CHAOS_FLAGS_CRC
+/*
+ * CRC-16 (CCITT) of the software checks on top of the hardware CRC.
+ */
+static const uint16_t crc16_table[256] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+	0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+	0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+	0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+	0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+	0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+	0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+	0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+	0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+	0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+	0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+	0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+	0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+	0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+	0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+	0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+	0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+	0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+	0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+	0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+	0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+	0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+static inline uint16_t chaos_crc16(uint16_t crc, const uint8_t *d, uint8_t len) {
+	while (len--) {
+		crc = (crc << 8) ^ crc16_table[(uint8_t)(crc >> 8) ^ *d++];
+	}
+	return crc;
+}
+#endif /* CHAOS_FEC || CHAOS_FLAGS_CRC */
+
+#if CHAOS_FEC
+/*
+ * FEC over the data (and the round number of bursts): CHAOS_FEC_SECTIONS sections,
+ * each with a CRC-16, and their XOR. A packet the hardware CRC rejects
+ * is still merged if at most one section fails its CRC: the XOR rebuilds it.
+ */
+static inline uint16_t fec_crc(const uint8_t *d, uint8_t len) {
+	return chaos_crc16(0xffff, d, len);
+}
+
+static inline uint8_t fec_section_len(uint8_t s) {
+	// the last sections are shorter (or empty) if the data does not split evenly
+	uint16_t start = (uint16_t)s * CHAOS_FEC_SECTION_LEN;
+	if (start >= CHAOS_FEC_COVERED) {
+		return 0;
+	}
+	return FEC_MIN(CHAOS_FEC_SECTION_LEN, CHAOS_FEC_COVERED - start);
+}
+
+static inline uint8_t fec_crc_ok(const uint8_t *d, const uint8_t *fec, uint8_t s) {
+	uint16_t crc = fec_crc(d + s * CHAOS_FEC_SECTION_LEN, fec_section_len(s));
+	return fec[2 * s] == (uint8_t)crc && fec[2 * s + 1] == (uint8_t)(crc >> 8);
+}
+
+static void chaos_fec_encode(uint8_t *d) {
+	uint8_t *fec = d + CHAOS_FEC_COVERED;
+	uint8_t *parity = fec + 2 * CHAOS_FEC_SECTIONS;
+	uint8_t s, i, len;
+	uint16_t crc;
+	memset(parity, 0, CHAOS_FEC_SECTION_LEN);
+	for (s = 0; s < CHAOS_FEC_SECTIONS; s++) {
+		len = fec_section_len(s);
+		crc = fec_crc(d + s * CHAOS_FEC_SECTION_LEN, len);
+		fec[2 * s] = (uint8_t)crc;
+		fec[2 * s + 1] = (uint8_t)(crc >> 8);
+		for (i = 0; i < len; i++) {
+			parity[i] ^= d[s * CHAOS_FEC_SECTION_LEN + i];
+		}
+	}
+}
+
+static uint8_t chaos_fec_repair(uint8_t *d) {
+	// not zero if every section checks out, after rebuilding at most one
+	uint8_t *fec = d + CHAOS_FEC_COVERED;
+	uint8_t *bad_section;
+	uint8_t s, i, len, bad = CHAOS_FEC_SECTIONS;
+	for (s = 0; s < CHAOS_FEC_SECTIONS; s++) {
+		if (!fec_crc_ok(d, fec, s)) {
+			if (bad != CHAOS_FEC_SECTIONS) {
+				// two bad sections: beyond repair
+				return 0;
+			}
+			bad = s;
+		}
+	}
+	if (bad == CHAOS_FEC_SECTIONS) {
+		// only the FEC field or the trailer were hit
+		return 1;
+	}
+	bad_section = d + bad * CHAOS_FEC_SECTION_LEN;
+	len = fec_section_len(bad);
+	memcpy(bad_section, fec + 2 * CHAOS_FEC_SECTIONS, len);
+	for (s = 0; s < CHAOS_FEC_SECTIONS; s++) {
+		if (s != bad) {
+			for (i = 0; i < len && i < fec_section_len(s); i++) {
+				bad_section[i] ^= d[s * CHAOS_FEC_SECTION_LEN + i];
+			}
+		}
+	}
+	// the parity itself may have been hit
+	return fec_crc_ok(d, fec, bad);
+}
+#endif /* CHAOS_FEC */
+
+#if CHAOS_FLAGS_CRC
+/*
+ * CRC-16 over the sequence number and the flags (and the round number of bursts),
+ * kept apart from the payload: when the hardware CRC fails but this one checks out,
+ * the flags are still merged. The header is not covered, as relays rewrite it
+ * and any value passing the header check is a valid one.
+ */
+#define CHAOS_FLAGS_COVERED          (offsetof(chaos_data_struct, flags) + MERGE_LEN)
+
+static inline uint16_t flags_crc(const uint8_t *d, uint8_t round) {
+	uint16_t crc = chaos_crc16(0xffff, d, CHAOS_FLAGS_COVERED);
+#if CHAOS_BURST > 1
+	crc = chaos_crc16(crc, &round, sizeof(round));
+#endif /* CHAOS_BURST */
+	return crc;
 }
 
+static inline void chaos_flags_crc_encode(uint8_t *d) {
+#if CHAOS_BURST > 1
+	uint16_t crc = flags_crc(d, burst_round);
+#else
+	uint16_t crc = flags_crc(d, 0);
+#endif /* CHAOS_BURST */
+	d[CHAOS_FLAGS_CRC_OFFSET] = (uint8_t)crc;
+	d[CHAOS_FLAGS_CRC_OFFSET + 1] = (uint8_t)(crc >> 8);
+}
+
+static inline uint8_t chaos_flags_crc_ok(const uint8_t *d) {
+	// d is the data of the received packet
+	uint16_t crc = flags_crc(d, (CHAOS_BURST > 1) ? CHAOS_ROUND() : 0);
+	return d[CHAOS_FLAGS_CRC_OFFSET] == (uint8_t)crc && d[CHAOS_FLAGS_CRC_OFFSET + 1] == (uint8_t)(crc >> 8);
+}
+#endif /* CHAOS_FLAGS_CRC */
+
+#if CHAOS_FEC || CHAOS_FLAGS_CRC
+static inline void chaos_encode_checks(uint8_t *d) {
+	// the software checks of the data d is about to be sent with
+#if CHAOS_FEC
+	chaos_fec_encode(d);
+#endif /* CHAOS_FEC */
+#if CHAOS_FLAGS_CRC
+	chaos_flags_crc_encode(d);
+#endif /* CHAOS_FLAGS_CRC */
+}
+#endif /* CHAOS_FEC || CHAOS_FLAGS_CRC */
+
 void chaos_data_processing(void){
 	chaos_data_struct* local = (chaos_data_struct*)data;
 	chaos_data_struct* received = (chaos_data_struct*)(&CHAOS_DATA_FIELD);
+#if CHAOS_TXFIFO_PATCH
+	memset(dirty_chunks, 0, CHAOS_CHUNK_MAP_LEN);
+#endif /* CHAOS_TXFIFO_PATCH */
 
 	uint8_t complete_temp = 0xFF;
 	uint16_t i;
@@ -211,7 +883,12 @@ void chaos_data_processing(void){
 #endif /* LOG_FLAGS */
 		tx |= (received->flags[i] != local_flag);
 		received->flags[i] |= local_flag;
+#if CHAOS_MEMBERSHIP
+		// flags of free indexes do not hold back completion
+		complete_temp &= received->flags[i] | ~received->members[i];
+#else
 		complete_temp &= received->flags[i];
+#endif /* CHAOS_MEMBERSHIP */
 	}
 	uint8_t local_flag = local->flags[MERGE_LEN-1];
 #if defined LOG_FLAGS && defined LOG_ALL_FLAGS
@@ -219,11 +896,45 @@ void chaos_data_processing(void){
 #endif /* LOG_FLAGS */
 	tx |= (received->flags[MERGE_LEN-1] != local_flag);
 	received->flags[MERGE_LEN-1] |= local_flag;
+#if CHAOS_MEMBERSHIP
+	chaos_complete = (complete_temp == 0xFF) &&
+			(((received->flags[MERGE_LEN-1] | ~received->members[MERGE_LEN-1]) & CHAOS_COMPLETE_FLAG) == CHAOS_COMPLETE_FLAG);
+#else
 	chaos_complete = (complete_temp == 0xFF) && (received->flags[MERGE_LEN-1] == CHAOS_COMPLETE_FLAG);
-
-//	for( i=0; i < PAYLOAD_LEN; i++ ){
-//		received->payload[i] = (received->payload[i] > local->payload[i]) ? received->payload[i] : local->payload[i];
-//	}
+#endif /* CHAOS_MEMBERSHIP */
+#if CHAOS_MULTI_INITIATOR
+	// concurrent starters may disagree on the sequence number: the highest one wins
+	if (local->seq_no > received->seq_no) {
+		received->seq_no = local->seq_no;
+		tx = 1;
+	} else if (received->seq_no > local->seq_no) {
+		// take it over (and relay it) even if nothing else changed
+		tx = 1;
+	}
+#endif /* CHAOS_MULTI_INITIATOR */
+#if CHAOS_AGREE
+	// vote on the proposal and merge the votes
+	tx |= chaos_agree_processing(local, received);
+#endif /* CHAOS_AGREE */
+#if CHAOS_ABCAST
+	// merge the message slots
+	tx |= chaos_abcast_processing(local, received);
+#endif /* CHAOS_ABCAST */
+#if CHAOS_MEMBERSHIP
+	// merge join requests and leaves
+	tx |= chaos_member_processing(local, received);
+#endif /* CHAOS_MEMBERSHIP */
+
+#if CHAOS_MERGE_OP != CHAOS_MERGE_NONE
+	// merge only the chunks holding data
+	chaos_payload_processing(local, received);
+#endif /* CHAOS_MERGE_OP */
+#if CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+	if (chaos_complete && !chaos_mux_done(received)) {
+		// the flags are complete, a section is not yet
+		chaos_complete = CHAOS_INCOMPLETE;
+	}
+#endif /* CHAOS_MERGE_OP */
 
 //	random processing
 //	uint16_t tmp = 0;
@@ -240,6 +951,107 @@ void chaos_data_processing(void){
 
 }
 
+#if CHAOS_FLAGS_CRC
+static inline void chaos_flags_rescue(void) {
+	// merge the flags of a packet failing the hardware CRC into the local data:
+	// OR is safe on flags whose own CRC checks out, the rest of the packet is dropped
+	chaos_data_struct* local = (chaos_data_struct*)data;
+	chaos_data_struct* received = (chaos_data_struct*)(&CHAOS_DATA_FIELD);
+	uint8_t complete_temp = 0xFF, changed = 0;
+	uint16_t i;
+	if ((!initiator && CHAOS_RX_CNT() == 0) || !chaos_flags_crc_ok(&CHAOS_DATA_FIELD) ||
+			received->seq_no != local->seq_no) {
+		// the local data is not from this round yet, or the flags are corrupted too
+		return;
+	}
+#if CHAOS_BURST > 1
+	if (CHAOS_ROUND() != burst_round) {
+		return;
+	}
+#endif /* CHAOS_BURST */
+	for (i = 0; i < MERGE_LEN; i++) {
+		changed |= received->flags[i] & ~local->flags[i];
+		local->flags[i] |= received->flags[i];
+#if CHAOS_MEMBERSHIP
+		complete_temp &= local->flags[i] | ~local->members[i];
+#else
+		complete_temp &= (i == MERGE_LEN - 1) ? local->flags[i] | ~CHAOS_COMPLETE_FLAG : local->flags[i];
+#endif /* CHAOS_MEMBERSHIP */
+	}
+	if (!changed) {
+		return;
+	}
+	chaos_complete = (complete_temp == 0xFF) ? CHAOS_COMPLETE : CHAOS_INCOMPLETE;
+#if CHAOS_MERGE_OP == CHAOS_MERGE_MUX
+	if (chaos_complete && !chaos_mux_done(local)) {
+		chaos_complete = CHAOS_INCOMPLETE;
+	}
+#endif /* CHAOS_MERGE_OP */
+	chaos_encode_checks(data);
+#if CHAOS_TXFIFO_PATCH
+	// the local data changed behind the TXFIFO
+	txfifo_loaded = 0;
+#endif /* CHAOS_TXFIFO_PATCH */
+#if CHAOS_DEBUG
+	flags_rescued++;
+#endif /* CHAOS_DEBUG */
+}
+#endif /* CHAOS_FLAGS_CRC */
+
+
+#if CHAOS_BURST > 1
+static inline void chaos_burst_advance(uint8_t round) {
+	// leave the current logical round: the slot timing stays the same
+	if (burst_hook) {
+		burst_hook(round, data);
+	}
+	burst_round = round;
+	burst_tx = 0;
+	chaos_complete = CHAOS_INCOMPLETE;
+	tx_cnt_complete = 0;
+#if !CHAOS_HEADER_VERSION
+	data[DATA_LEN] = round;
+#endif /* CHAOS_HEADER_VERSION */
+#if CHAOS_FEC || CHAOS_FLAGS_CRC
+	chaos_encode_checks(data);
+#endif /* CHAOS_FEC || CHAOS_FLAGS_CRC */
+#if CHAOS_TXFIFO_PATCH
+	// the local data changed as a whole
+	txfifo_loaded = 0;
+#endif /* CHAOS_TXFIFO_PATCH */
+}
+
+static inline uint8_t chaos_burst_accept(void) {
+	if (CHAOS_ROUND() == burst_round) {
+		return 1;
+	}
+#if CHAOS_HEADER_VERSION
+	if (CHAOS_RX_REPAIRED()) {
+		// the round id in the header is not covered by FEC
+		return 0;
+	}
+#endif /* CHAOS_HEADER_VERSION */
+	if (CHAOS_ROUND() < burst_round || CHAOS_ROUND() >= CHAOS_BURST) {
+		// a late relay of an earlier round
+		return 0;
+	}
+	// the next round has started
+	chaos_burst_advance(CHAOS_ROUND());
+	return 1;
+}
+
+static inline void chaos_burst_next(void) {
+	state = CHAOS_STATE_WAITING;
+	if (initiator) {
+		// start the next round from our own data when the timeout expires
+		packet_use_local();
+		chaos_burst_advance(burst_round + 1);
+	} else {
+		// wait for the initiator to start it
+		chaos_stop_timeout();
+	}
+}
+#endif /* CHAOS_BURST */
 
 /* --------------------------- SFD interrupt ------------------------ */
 interrupt(TIMERB1_VECTOR) __attribute__ ((section(".chaos")))
@@ -259,13 +1071,45 @@ timerb1_interrupt(void)
 		FASTSPI_READ_FIFO_NO_WAIT(&packet[bytes_read], PACKET_LEN - bytes_read + 1);
 		bytes_read = PACKET_LEN + 1;
 
-		if (CHAOS_CRC_FIELD & FOOTER1_CRC_OK) {
+#if CHAOS_FEC
+		fec_repaired = !(CHAOS_CRC_FIELD & FOOTER1_CRC_OK) && chaos_fec_repair(&CHAOS_DATA_FIELD);
+#endif /* CHAOS_FEC */
+#if CHAOS_BURST > 1
+		if (CHAOS_RX_OK() && chaos_burst_accept()) {
+#else
+		if (CHAOS_RX_OK()) {
+#endif /* CHAOS_BURST */
 			// CRC ok: packet successfully received
 			SET_PIN_ADC7;
-			// stop the timeout
-			chaos_stop_timeout();
+			if (!CHAOS_RX_REPAIRED()) {
+				// stop the timeout (a repaired packet is only sent when it expires)
+				chaos_stop_timeout();
+			}
 			// data processing
 			chaos_data_processing();
+#if CHAOS_FEC
+			if (fec_repaired) {
+				// neither the relay counter nor the timing of a corrupted packet can be trusted:
+				// keep the merged data and send it when the timeout expires
+				tx = 0;
+#if CHAOS_DEBUG
+				fec_rescued++;
+#endif /* CHAOS_DEBUG */
+			}
+#endif /* CHAOS_FEC */
+#if CHAOS_FEC || CHAOS_FLAGS_CRC
+			chaos_encode_checks(&CHAOS_DATA_FIELD);
+#endif /* CHAOS_FEC || CHAOS_FLAGS_CRC */
+#if CHAOS_TXFIFO_PATCH
+			chaos_dirty_range();
+#endif /* CHAOS_TXFIFO_PATCH */
+#if CHAOS_HOPPING && CHAOS_HOP_RELAYS
+			// the next slot might be on the next channel of this round:
+			// STXON calibrates the radio anyway, only listeners need SRXON
+			if (chaos_hop(CHAOS_RELAY_CNT_FIELD + 1) && !tx) {
+				FASTSPI_STROBE(CC2420_SRXON);
+			}
+#endif /* CHAOS_HOPPING && CHAOS_HOP_RELAYS */
 
 			//ok, data processing etc is done and we are ready to transmit a packet
 			//now the black magic part starts:
@@ -343,10 +1187,22 @@ timerb1_interrupt(void)
 				chaos_end_rx();
 			}
 		} else {
-			// CRC not ok
+			// CRC not ok (or packet of an earlier round of the burst)
+#if CHAOS_FEC
+			fec_repaired = 0;
+#endif /* CHAOS_FEC */
+#if CHAOS_FLAGS_CRC
+			if (!(CHAOS_CRC_FIELD & FOOTER1_CRC_OK)) {
+				// the flags might still be intact
+				chaos_flags_rescue();
+			}
+#endif /* CHAOS_FLAGS_CRC */
+			if (!(CHAOS_CRC_FIELD & FOOTER1_CRC_OK)) {
+				crc_err_cnt++;
 #if CHAOS_DEBUG
-			bad_crc++;
+				bad_crc++;
 #endif /* CHAOS_DEBUG */
+			}
 			tx = 0;
 			// read TBIV to clear IFG
 			tbiv = TBIV;
@@ -377,33 +1233,34 @@ timerb1_interrupt(void)
 								n_timeout_wait--;
 							} else {
 								if (state == CHAOS_STATE_WAITING) {
+#if CHAOS_HOPPING && CHAOS_HOP_RELAYS
+									// move to the channel of the slot we are going to transmit in
+									chaos_hop(relay_cnt_timeout);
+#endif /* CHAOS_HOPPING && CHAOS_HOP_RELAYS */
 									// start another transmission
 									radio_start_tx();
 									UNSET_PIN_ADC6;
+									// retransmit the local data as it is
+									packet_use_local();
 									if (initiator && rx_cnt == 0) {
 										CHAOS_LEN_FIELD = PACKET_LEN;
-										CHAOS_HEADER_FIELD = CHAOS_HEADER;
+										CHAOS_SET_HEADER(CHAOS_HEADER);
 									} else {
 										// stop estimating the slot length during this round (to keep maximum precision)
 										estimate_length = 0;
 										CHAOS_LEN_FIELD = PACKET_LEN;
-										CHAOS_HEADER_FIELD = CHAOS_HEADER+1;
+										CHAOS_SET_HEADER(CHAOS_HEADER_TIMEOUT);
 									}
-									CHAOS_RELAY_CNT_FIELD = relay_cnt_timeout;
-									if (DATA_LEN > BYTES_TIMEOUT) {
-										// first BYTES_TIMEOUT bytes
-										memcpy(&CHAOS_DATA_FIELD, data, BYTES_TIMEOUT);
-										radio_flush_rx();
-										FASTSPI_WRITE_FIFO(packet, BYTES_TIMEOUT + 1 + CHAOS_HEADER_LEN);
-										// remaining bytes
-										memcpy(&CHAOS_BYTES_TIMEOUT_FIELD, &data[BYTES_TIMEOUT], DATA_LEN - BYTES_TIMEOUT);
-										FASTSPI_WRITE_FIFO(&packet[BYTES_TIMEOUT + 1 + CHAOS_HEADER_LEN], PACKET_LEN - BYTES_TIMEOUT - 1 - CHAOS_HEADER_LEN - 1);
-									} else {
-										memcpy(&CHAOS_DATA_FIELD, data, DATA_LEN);
-										// write the packet to the TXFIFO
-										radio_flush_rx();
-										radio_write_tx();
+									if (CHAOS_SYNC_MODE) {
+										CHAOS_RELAY_CNT_FIELD = relay_cnt_timeout;
 									}
+#if CHAOS_TXFIFO_PATCH
+									// the local data did not change since the last transmission
+									chaos_dirty_clear();
+#endif /* CHAOS_TXFIFO_PATCH */
+									// write the packet to the TXFIFO
+									radio_flush_rx();
+									radio_update_tx();
 									state = CHAOS_STATE_RECEIVED;
 								} else {
 									// stop the timeout
@@ -414,6 +1271,7 @@ timerb1_interrupt(void)
 							if (state != CHAOS_STATE_OFF) {
 								// something strange is going on: go back to the waiting state
 								radio_flush_rx();
+								packet_use_local();
 								// stop the timeout
 								chaos_stop_timeout();
 								state = CHAOS_STATE_WAITING;
@@ -448,6 +1306,12 @@ PROCESS_THREAD(chaos_process, ev, data) {
 		// prevent the Contiki main cycle to enter the LPM mode or
 		// any other process to run while Chaos is running
 		while (CHAOS_IS_ON());
+		// Chaos turned itself off before being stopped: the round is over for this node
+		int s = splhigh();
+		if (!stopped && off_hook) {
+			off_hook();
+		}
+		splx(s);
 	}
 
 	PROCESS_END();
@@ -512,11 +1376,12 @@ static inline void chaos_enable_other_interrupts(void) {
 }
 
 /* --------------------------- Main interface ----------------------- */
-void chaos_start(uint8_t *data_, /*uint8_t data_len_,*/ uint8_t initiator_,
-		/*uint8_t sync_,*/ uint8_t tx_max_) {
+uint8_t *chaos_get_data(void) {
+	return data;
+}
+
+void chaos_start(uint8_t initiator_, /*uint8_t sync_,*/ uint8_t tx_max_) {
 	// copy function arguments to the respective Chaos variables
-	data = data_;
-//	data_len = data_len_;
 	initiator = initiator_;
 //	sync = sync_;
 	tx_max = tx_max_;
@@ -525,10 +1390,15 @@ void chaos_start(uint8_t *data_, /*uint8_t data_len_,*/ uint8_t initiator_,
 	// initialize Chaos variables
 	tx_cnt = 0;
 	rx_cnt = 0;
+#if CHAOS_FEC
+	fec_rx_cnt = 0;
+#endif /* CHAOS_FEC */
+	crc_err_cnt = 0;
 
 	chaos_complete = CHAOS_INCOMPLETE;
 	tx_cnt_complete = 0;
 	estimate_length = 1;
+	stopped = 0;
 
 #if CHAOS_DEBUG
 	rc_update = 0;
@@ -537,17 +1407,31 @@ void chaos_start(uint8_t *data_, /*uint8_t data_len_,*/ uint8_t initiator_,
 //	packet_len = (CHAOS_SYNC_MODE) ?
 //			DATA_LEN + FOOTER_LEN + CHAOS_RELAY_CNT_LEN + CHAOS_HEADER_LEN :
 //			DATA_LEN + FOOTER_LEN + CHAOS_HEADER_LEN;
-	// allocate memory for the temporary buffer
-	packet = (uint8_t *) malloc(PACKET_LEN + 1);
+	// the application data is already in place in the local buffer
+	packet_use_local();
 	// set the packet length field to the appropriate value
 	CHAOS_LEN_FIELD = PACKET_LEN;
+#if CHAOS_BURST > 1
+	// first logical round of the burst
+	burst_round = 0;
+	burst_tx = 0;
+#if !CHAOS_HEADER_VERSION
+	CHAOS_ROUND_FIELD = 0;
+#endif /* CHAOS_HEADER_VERSION */
+#endif /* CHAOS_BURST */
 	// set the header field
-	CHAOS_HEADER_FIELD = CHAOS_HEADER;
+	CHAOS_SET_HEADER(CHAOS_HEADER);
+#if CHAOS_HEADER_VERSION
+	CHAOS_HEADER_EXT_FIELD = CHAOS_HEADER_EXT;
+#endif /* CHAOS_HEADER_VERSION */
+#if CHAOS_FEC
+	fec_repaired = 0;
+#endif /* CHAOS_FEC */
+#if CHAOS_FEC || CHAOS_FLAGS_CRC
+	chaos_encode_checks(data);
+#endif /* CHAOS_FEC || CHAOS_FLAGS_CRC */
 	if (initiator) {
-		// initiator: copy the application data to the data field
-		//OL: from local data to packet that will be tx
-		memcpy(&CHAOS_DATA_FIELD, data, DATA_LEN);
-		// set Chaos state
+		// initiator: set Chaos state
 		state = CHAOS_STATE_RECEIVED;
 	} else {
 		// receiver: set Chaos state
@@ -559,15 +1443,37 @@ void chaos_start(uint8_t *data_, /*uint8_t data_len_,*/ uint8_t initiator_,
 		// the reference time has not been updated yet
 		t_ref_l_updated = 0;
 	}
+#if !CHAOS_SYNC_MODE
+	// no slot estimation: timeouts use the nominal slot length
+	T_slot_h = CHAOS_NO_SYNC_T_SLOT_H;
+#endif /* CHAOS_SYNC_MODE */
 
 #if !COOJA
 	// resynchronize the DCO
 	msp430_sync_dco();
 #endif /* COOJA */
 
+#if CHAOS_HOPPING
+	// start on the first channel of this round
+	hop_idx = 0;
+	radio_set_channel(0);
+#else
+	FASTSPI_SETREG(CC2420_FSCTRL, CC2420_FSCTRL_CHANNEL(channel));
+#endif /* CHAOS_HOPPING */
+	if (tx_power != tx_power_set) {
+		// new transmit power: PA_LEVEL, the low bits of TXCTRL
+		uint16_t reg;
+		FASTSPI_GETREG(CC2420_TXCTRL, reg);
+		FASTSPI_SETREG(CC2420_TXCTRL, (reg & 0xffe0) | (tx_power & 0x1f));
+		tx_power_set = tx_power;
+	}
+
 	// flush radio buffers
 	radio_flush_rx();
 	radio_flush_tx();
+#if CHAOS_TXFIFO_PATCH
+	txfifo_loaded = 0;
+#endif /* CHAOS_TXFIFO_PATCH */
 	if (initiator) {
 		// write the packet to the TXFIFO
 		radio_write_tx();
@@ -581,7 +1487,36 @@ void chaos_start(uint8_t *data_, /*uint8_t data_len_,*/ uint8_t initiator_,
 	process_poll(&chaos_process);
 }
 
+uint8_t chaos_initiate(uint8_t relay_cnt_) {
+	if (state != CHAOS_STATE_WAITING || CHAOS_RX_CNT() || SFD_IS_1) {
+		// somebody else already started the round: keep relaying
+		return 0;
+	}
+	initiator = 1;
+	packet_use_local();
+	CHAOS_LEN_FIELD = PACKET_LEN;
+	CHAOS_SET_HEADER(CHAOS_HEADER);
+#if CHAOS_HEADER_VERSION
+	CHAOS_HEADER_EXT_FIELD = CHAOS_HEADER_EXT;
+#endif /* CHAOS_HEADER_VERSION */
+	if (CHAOS_SYNC_MODE) {
+		// same relay counter as any other node starting at this time
+		CHAOS_RELAY_CNT_FIELD = relay_cnt_;
+	}
+#if CHAOS_FEC || CHAOS_FLAGS_CRC
+	// the application may have changed the data since chaos_start
+	chaos_encode_checks(data);
+#endif /* CHAOS_FEC || CHAOS_FLAGS_CRC */
+	state = CHAOS_STATE_RECEIVED;
+	// write the packet to the TXFIFO and start the first transmission
+	radio_flush_rx();
+	radio_write_tx();
+	radio_start_tx();
+	return 1;
+}
+
 uint8_t chaos_stop(void) {
+	stopped = 1;
 	// turn off the radio
 	radio_off();
 
@@ -592,14 +1527,294 @@ uint8_t chaos_stop(void) {
 	state = CHAOS_STATE_OFF;
 	// re-enable non Chaos-related interrupts
 	chaos_enable_other_interrupts();
-	// deallocate memory for the temporary buffer
-	free(packet);
+	packet_use_local();
 	// return the number of times the packet has been received
-	return rx_cnt;
+	return CHAOS_RX_CNT();
+}
+
+void chaos_set_channel(uint8_t channel_) {
+	channel = channel_;
+}
+
+void chaos_set_tx_power(uint8_t power) {
+	tx_power = power;
+}
+
+void chaos_set_hop_seq_no(unsigned long seq_no) {
+#if CHAOS_HOPPING
+	hop_seq_no = seq_no;
+#endif /* CHAOS_HOPPING */
+}
+
+void chaos_set_off_hook(void (*hook)(void)) {
+	off_hook = hook;
+}
+
+void chaos_set_burst_hook(void (*hook)(uint8_t round, uint8_t *data)) {
+#if CHAOS_BURST > 1
+	burst_hook = hook;
+#endif /* CHAOS_BURST */
+}
+
+uint8_t get_burst_round(void) {
+#if CHAOS_BURST > 1
+	return burst_round;
+#else
+	return 0;
+#endif /* CHAOS_BURST */
+}
+
+static uint8_t wakeup_loaded;
+
+void chaos_wakeup(void) {
+#if CHAOS_HEADER_VERSION
+	static const uint8_t wakeup_frame[] = {CHAOS_WAKEUP_LEN, CHAOS_HEADER, CHAOS_HEADER_EXT};
+#else
+	static const uint8_t wakeup_frame[] = {CHAOS_WAKEUP_LEN, CHAOS_HEADER};
+#endif /* CHAOS_HEADER_VERSION */
+	rtimer_clock_t t_stop = RTIMER_NOW() + CHAOS_WAKEUP_FRAME_TIME;
+	if (!wakeup_loaded) {
+		// the frame stays in the TXFIFO: each STXON sends it again
+		radio_flush_tx();
+		FASTSPI_WRITE_FIFO(wakeup_frame, sizeof(wakeup_frame));
+		wakeup_loaded = 1;
+	}
+	FASTSPI_STROBE(CC2420_STXON);
+	ENERGEST_ON(ENERGEST_TYPE_TRANSMIT);
+	// wait for the end of the frame, at most for its airtime
+	while (!SFD_IS_1 && RTIMER_CLOCK_LT(RTIMER_NOW(), t_stop));
+	while (SFD_IS_1 && RTIMER_CLOCK_LT(RTIMER_NOW(), t_stop));
+	ENERGEST_OFF(ENERGEST_TYPE_TRANSMIT);
+	FASTSPI_STROBE(CC2420_SRFOFF);
+}
+
+void chaos_wakeup_end(void) {
+	FASTSPI_STROBE(CC2420_SRFOFF);
+	radio_flush_tx();
+	wakeup_loaded = 0;
+}
+
+static inline uint8_t lpl_read_wakeup(void) {
+	// returns not zero if the frame in the RXFIFO is a wake-up frame with a good CRC
+	uint8_t frame[1 + CHAOS_WAKEUP_LEN];
+	uint8_t ok = 0;
+	FASTSPI_READ_FIFO_BYTE(frame[0]);
+	if (frame[0] == CHAOS_WAKEUP_LEN) {
+		FASTSPI_READ_FIFO_NO_WAIT(&frame[1], CHAOS_WAKEUP_LEN);
+		ok = (frame[CHAOS_WAKEUP_LEN] & FOOTER1_CRC_OK) && frame[1] == CHAOS_HEADER;
+#if CHAOS_HEADER_VERSION
+		ok = ok && ((frame[2] & CHAOS_HEADER_EXT_MASK) == (CHAOS_HEADER_EXT & CHAOS_HEADER_EXT_MASK));
+#endif /* CHAOS_HEADER_VERSION */
+	}
+	radio_flush_rx();
+	return ok;
+}
+
+uint8_t chaos_lpl_check(void) {
+	rtimer_clock_t t_stop, t_end;
+	uint8_t heard = 0;
+	radio_on();
+	t_stop = RTIMER_NOW() + CHAOS_LPL_LISTEN;
+	while (!heard && RTIMER_CLOCK_LT(RTIMER_NOW(), t_stop)) {
+		if (SFD_IS_1) {
+			// a frame: wait for its end, then check that it is a wake-up frame
+			t_end = RTIMER_NOW() + CHAOS_WAKEUP_FRAME_TIME;
+			while (SFD_IS_1 && RTIMER_CLOCK_LT(RTIMER_NOW(), t_end));
+			if (SFD_IS_1) {
+				// too long for a wake-up frame
+				while (SFD_IS_1 && RTIMER_CLOCK_LT(RTIMER_NOW(), t_stop));
+				radio_flush_rx();
+			} else {
+				heard = lpl_read_wakeup();
+			}
+		}
+	}
+	radio_off();
+	radio_flush_rx();
+	return heard;
+}
+
+/*
+ * Join requests and replies: chaos_join_process does the busy waiting, with
+ * interrupts enabled, in a window started and ended from the rtimer.
+ */
+#define JOIN_IDLE  0
+#define JOIN_ASK   1
+#define JOIN_SERVE 2
+static volatile uint8_t join_mode = JOIN_IDLE;
+static rtimer_clock_t join_t_stop;
+static chaos_join_info join_info;
+static volatile uint8_t join_result;
+
+#define JOIN_OPEN() (join_mode != JOIN_IDLE && RTIMER_CLOCK_LT(RTIMER_NOW(), join_t_stop))
+
+static inline uint8_t join_wait_frame(rtimer_clock_t t_stop, rtimer_clock_t *t_sfd) {
+	// poll for the SFD of the next frame, then for its end, within the window
+	int s;
+	uint8_t sfd = 0;
+	while (!sfd) {
+		if (!RTIMER_CLOCK_LT(RTIMER_NOW(), t_stop) || !JOIN_OPEN()) {
+			return 0;
+		}
+		// timestamp the SFD without an interrupt in between
+		s = splhigh();
+		sfd = SFD_IS_1;
+		*t_sfd = RTIMER_NOW();
+		splx(s);
+	}
+	while (SFD_IS_1) {
+		if (!RTIMER_CLOCK_LT(RTIMER_NOW(), *t_sfd + CHAOS_JOIN_FRAME_TIME) || !JOIN_OPEN()) {
+			// longer than any frame, or out of time: drop whatever is in the RXFIFO
+			radio_flush_rx();
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static inline uint8_t join_read_frame(uint8_t *frame, uint8_t len) {
+	// returns the kind of a join frame of length len with a good CRC, zero for anything else
+	uint8_t kind = 0;
+	FASTSPI_READ_FIFO_BYTE(frame[0]);
+	if (frame[0] == len) {
+		FASTSPI_READ_FIFO_NO_WAIT(&frame[1], len);
+		if ((frame[len] & FOOTER1_CRC_OK) && frame[1] == CHAOS_JOIN_HEADER) {
+			kind = frame[2];
+		}
+	}
+	radio_flush_rx();
+	return kind;
+}
+
+static inline void join_tx(const uint8_t *frame, uint8_t len) {
+	// the FCS is appended by the radio, which goes back to RX afterwards
+	radio_flush_tx();
+	FASTSPI_WRITE_FIFO(frame, len + 1 - FOOTER_LEN);
+	FASTSPI_STROBE(CC2420_STXON);
+}
+
+static inline void join_tx_wait(void) {
+	rtimer_clock_t t_stop = RTIMER_NOW() + CHAOS_JOIN_REPLY_WAIT;
+#if ENERGEST_CONF_ON
+	ENERGEST_OFF(ENERGEST_TYPE_LISTEN);
+	ENERGEST_ON(ENERGEST_TYPE_TRANSMIT);
+#endif /* ENERGEST_CONF_ON */
+	while (!SFD_IS_1 && RTIMER_CLOCK_LT(RTIMER_NOW(), t_stop));
+	t_stop = RTIMER_NOW() + CHAOS_JOIN_FRAME_TIME;
+	while (SFD_IS_1 && RTIMER_CLOCK_LT(RTIMER_NOW(), t_stop));
+#if ENERGEST_CONF_ON
+	ENERGEST_OFF(ENERGEST_TYPE_TRANSMIT);
+	ENERGEST_ON(ENERGEST_TYPE_LISTEN);
+#endif /* ENERGEST_CONF_ON */
+}
+
+static inline uint8_t join_has_time(void) {
+	// a frame sent now ends before the window does
+	return RTIMER_CLOCK_LT(RTIMER_NOW() + CHAOS_JOIN_REPLY_WAIT + CHAOS_JOIN_FRAME_TIME, join_t_stop);
+}
+
+static uint8_t join_ask(void) {
+	static const uint8_t request[] = {CHAOS_JOIN_REQUEST_LEN, CHAOS_JOIN_HEADER, CHAOS_JOIN_REQUEST};
+	uint8_t reply[1 + CHAOS_JOIN_REPLY_LEN];
+	rtimer_clock_t t_sfd, t_quiet = RTIMER_NOW();
+	while (JOIN_OPEN()) {
+		if (!RTIMER_CLOCK_LT(RTIMER_NOW(), t_quiet) && join_has_time()) {
+			join_tx(request, CHAOS_JOIN_REQUEST_LEN);
+			join_tx_wait();
+		}
+		// listen for a reply, or for whatever else is on the channel
+		if (join_wait_frame(RTIMER_NOW() + CHAOS_JOIN_REPLY_WAIT, &t_sfd)) {
+			if (join_read_frame(reply, CHAOS_JOIN_REPLY_LEN) == CHAOS_JOIN_REPLY) {
+				memcpy(&join_info, &reply[3], sizeof(chaos_join_info));
+				t_ref_l = t_sfd - join_info.t_since_ref;
+				t_ref_l_updated = 1;
+				return 1;
+			}
+			// a round or another node joining: the neighbors answer once the channel is quiet
+			t_quiet = RTIMER_NOW() + CHAOS_JOIN_QUIET;
+		}
+	}
+	return 0;
+}
+
+static uint8_t join_serve(void) {
+	uint8_t request[1 + CHAOS_JOIN_REQUEST_LEN];
+	uint8_t reply[1 + CHAOS_JOIN_REPLY_LEN - FOOTER_LEN];
+	rtimer_clock_t t_sfd;
+	uint8_t served = 0;
+	int s;
+	reply[0] = CHAOS_JOIN_REPLY_LEN;
+	reply[1] = CHAOS_JOIN_HEADER;
+	reply[2] = CHAOS_JOIN_REPLY;
+	while (join_wait_frame(join_t_stop, &t_sfd)) {
+		if (join_read_frame(request, CHAOS_JOIN_REQUEST_LEN) == CHAOS_JOIN_REQUEST &&
+				((RTIMER_NOW() + RTIMER_NOW_DCO()) & 1) && join_has_time()) {
+			// the SFD of the reply follows CHAOS_JOIN_TX_DELAY from now: no interrupt in between
+			s = splhigh();
+			join_info.t_since_ref = RTIMER_NOW() + CHAOS_JOIN_TX_DELAY - t_ref_l;
+			memcpy(&reply[3], &join_info, sizeof(chaos_join_info));
+			join_tx(reply, CHAOS_JOIN_REPLY_LEN);
+			splx(s);
+			join_tx_wait();
+			served++;
+		}
+	}
+	return served;
+}
+
+PROCESS(chaos_join_process, "Chaos join");
+PROCESS_THREAD(chaos_join_process, ev, data) {
+	PROCESS_BEGIN();
+
+	while (1) {
+		PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+		if (join_mode == JOIN_IDLE) {
+			// the window ended before we got to run
+			continue;
+		}
+		FASTSPI_SETREG(CC2420_FSCTRL, CC2420_FSCTRL_CHANNEL(RF_CHANNEL));
+		radio_on();
+		radio_flush_rx();
+		join_result = (join_mode == JOIN_ASK) ? join_ask() : join_serve();
+		radio_off();
+		radio_flush_rx();
+		radio_flush_tx();
+		join_mode = JOIN_IDLE;
+	}
+
+	PROCESS_END();
+}
+
+void chaos_join(rtimer_clock_t t_stop) {
+	join_t_stop = t_stop;
+	join_result = 0;
+	join_mode = JOIN_ASK;
+	process_poll(&chaos_join_process);
+}
+
+void chaos_join_serve(rtimer_clock_t t_stop, const chaos_join_info *info) {
+	join_info = *info;
+	join_t_stop = t_stop;
+	join_result = 0;
+	join_mode = JOIN_SERVE;
+	process_poll(&chaos_join_process);
+}
+
+uint8_t chaos_join_end(chaos_join_info *info) {
+	// the process leaves its loop at its next check
+	join_mode = JOIN_IDLE;
+	if (info && join_result) {
+		*info = join_info;
+	}
+	return join_result;
 }
 
 uint8_t get_rx_cnt(void) {
-	return rx_cnt;
+	return CHAOS_RX_CNT();
+}
+
+uint8_t get_crc_err_cnt(void) {
+	return crc_err_cnt;
 }
 
 uint8_t get_relay_cnt(void) {
@@ -618,10 +1833,22 @@ rtimer_clock_t get_t_first_rx_l(void) {
 	return t_first_rx_l;
 }
 
+uint8_t get_complete(void) {
+	return chaos_complete;
+}
+
+rtimer_clock_t get_t_complete_l(void) {
+	return t_complete_l;
+}
+
 rtimer_clock_t get_t_ref_l(void) {
 	return t_ref_l;
 }
 
+rtimer_clock_t get_T_offset_h(void) {
+	return T_offset_h;
+}
+
 void set_t_ref_l(rtimer_clock_t t) {
 	t_ref_l = t;
 }
@@ -634,36 +1861,61 @@ uint8_t get_state(void) {
 	return state;
 }
 
+static inline uint16_t slot_median(void) {
+	// median of the stored observations, sorted in a copy
+	uint16_t sorted[CHAOS_SLOT_MEDIAN], v;
+	uint8_t i, j;
+	for (i = 0; i < slot_obs_cnt; i++) {
+		v = slot_obs[i];
+		for (j = i; j > 0 && sorted[j - 1] > v; j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = v;
+	}
+	return sorted[slot_obs_cnt / 2];
+}
+
+static inline void slot_filter(uint32_t T_slot_h_obs) {
+	uint16_t median;
+	slot_obs[slot_obs_next] = (uint16_t)T_slot_h_obs;
+	slot_obs_next = (slot_obs_next + 1) % CHAOS_SLOT_MEDIAN;
+	if (slot_obs_cnt < CHAOS_SLOT_MEDIAN) {
+		slot_obs_cnt++;
+	}
+	median = slot_median();
+	if (slot_n == CHAOS_SYNC_WINDOW && (median > T_slot_h + CHAOS_SLOT_GATE || median + CHAOS_SLOT_GATE < T_slot_h)) {
+		if (++slot_rejects < CHAOS_SLOT_MEDIAN) {
+			// an outlier the median let through
+			return;
+		}
+		// the slot length did change: start over
+		slot_n = 0;
+	}
+	slot_rejects = 0;
+	// Kalman filter of a constant: gain 1/n, floored to follow slow drifts
+	if (slot_n < CHAOS_SYNC_WINDOW) {
+		slot_n++;
+	}
+	T_slot_q += (((int32_t)median << CHAOS_SLOT_Q) - (int32_t)T_slot_q) / slot_n;
+	T_slot_h = (T_slot_q + (1 << (CHAOS_SLOT_Q - 1))) >> CHAOS_SLOT_Q;
+}
+
 static inline void estimate_slot_length(rtimer_clock_t t_rx_stop_tmp) {
-	// estimate slot length if rx_cnt > 1
-	// and we have received a packet immediately after our last transmission
-	if ((rx_cnt > 1) && (CHAOS_RELAY_CNT_FIELD == (tx_relay_cnt_last + 2))) {
+	// estimate slot length if rx_cnt > 1 and we have received a packet
+	// at most CHAOS_SLOT_MAX_SPAN slots after the one preceding our last transmission
+	// (the relay counter is already incremented: the slot right after our transmission
+	// has tx_relay_cnt_last + 2, two slots after the preceding reception)
+	uint8_t span = CHAOS_RELAY_CNT_FIELD - tx_relay_cnt_last;
+	if ((rx_cnt > 1) && (CHAOS_RELAY_CNT_FIELD >= tx_relay_cnt_last + 2) && (span <= CHAOS_SLOT_MAX_SPAN)) {
 		T_w_rt_h = t_tx_start - t_rx_stop;
 		T_tx_h = t_tx_stop - t_tx_start;
+		// spans the slots nobody was heard in, if any
 		T_w_tr_h = t_rx_start - t_tx_stop;
 		T_rx_h = t_rx_stop_tmp - t_rx_start;
-		uint32_t T_slot_h_tmp = ((uint32_t)T_tx_h + (uint32_t)T_w_tr_h + (uint32_t)T_rx_h + (uint32_t)T_w_rt_h) / 2;
-#if CHAOS_SYNC_WINDOW
-		T_slot_h_sum += T_slot_h_tmp;
-		if ((++win_cnt) == CHAOS_SYNC_WINDOW) {
-			// update the slot length estimation
-			T_slot_h = T_slot_h_sum / CHAOS_SYNC_WINDOW;
-			// halve the counters
-			T_slot_h_sum /= 2;
-			win_cnt /= 2;
-		} else {
-			if (win_cnt == 1) {
-				// at the beginning, use the first estimation of the slot length
-				T_slot_h = T_slot_h_tmp;
-			}
-		}
-		estimate_length = 0;
+		slot_filter(((uint32_t)T_tx_h + (uint32_t)T_w_tr_h + (uint32_t)T_rx_h + (uint32_t)T_w_rt_h) / span);
 #if CHAOS_DEBUG
 		rc_update = CHAOS_RELAY_CNT_FIELD;
 #endif /* CHAOS_DEBUG */
-#else
-		T_slot_h = T_slot_h_tmp;
-#endif /* CHAOS_SYNC_WINDOW */
 	}
 }
 
@@ -692,6 +1944,7 @@ static inline void compute_sync_reference_time(void) {
 /* ----------------------- Interrupt functions ---------------------- */
 inline void chaos_begin_rx(void) {
 	SET_PIN_ADC1;
+	packet_use_rx();
 	t_rx_start = TBCCR1;
 	state = CHAOS_STATE_RECEIVING;
 	// Rx timeout: packet duration + 200 us
@@ -749,7 +2002,7 @@ inline void chaos_begin_rx(void) {
 	// read the second byte (i.e., the header field) from the RXFIFO
 	FASTSPI_READ_FIFO_BYTE(CHAOS_HEADER_FIELD);
 	// keep receiving only if it has the right header
-	if (CHAOS_HEADER_FIELD < CHAOS_HEADER) {
+	if (!CHAOS_HEADER_OK(CHAOS_HEADER_FIELD)) {
 		// packet with a wrong header: abort packet reception
 		radio_abort_rx();
 #if CHAOS_DEBUG
@@ -757,7 +2010,30 @@ inline void chaos_begin_rx(void) {
 #endif /* CHAOS_DEBUG */
 		return;
 	}
+#if CHAOS_HEADER_VERSION
+	// wait until the third byte (i.e., the header extension) is received
+	while (!FIFO_IS_1) {
+		if (!RTIMER_CLOCK_LT(RTIMER_NOW_DCO(), t_rx_timeout)) {
+			radio_abort_rx();
+#if CHAOS_DEBUG
+			rx_timeout++;
+#endif /* CHAOS_DEBUG */
+			return;
+		}
+	};
+	FASTSPI_READ_FIFO_BYTE(CHAOS_HEADER_EXT_FIELD);
+	// keep receiving only if it uses the same merge operator and encoding
+	if ((CHAOS_HEADER_EXT_FIELD & CHAOS_HEADER_EXT_MASK) != CHAOS_HEADER_EXT) {
+		radio_abort_rx();
+#if CHAOS_DEBUG
+		bad_header++;
+#endif /* CHAOS_DEBUG */
+		return;
+	}
+	bytes_read = 3;
+#else
 	bytes_read = 2;
+#endif /* CHAOS_HEADER_VERSION */
 	if (PACKET_LEN > 8) {
 		// if packet is longer than 8 bytes, read all bytes but the last 8
 		while (bytes_read <= PACKET_LEN - 8) {
@@ -793,16 +2069,20 @@ inline void chaos_end_rx(void) {
 		} else {
 			// write Chaos packet to the TXFIFO
 			if (chaos_complete == CHAOS_COMPLETE) {
-				CHAOS_HEADER_FIELD = CHAOS_HEADER+1;
+				CHAOS_SET_HEADER(CHAOS_HEADER_TIMEOUT);
 			}
 			radio_flush_rx();
-			radio_write_tx();
+			radio_update_tx();
 			state = CHAOS_STATE_RECEIVED;
 		}
 		if (rx_cnt == 0) {
 			// first successful reception: store current time
 			t_first_rx_l = RTIMER_NOW();
 		}
+		if (chaos_complete == CHAOS_COMPLETE && tx_cnt_complete == 0) {
+			// first complete reception: store current time
+			t_complete_l = RTIMER_NOW();
+		}
 
 #ifdef LOG_TIRQ
 		if (tirq_log_cnt < CHAOS_TIRQ_LOG_SIZE) {
@@ -812,11 +2092,12 @@ inline void chaos_end_rx(void) {
 #endif
 
 		rx_cnt++;
-		if (CHAOS_SYNC_MODE && estimate_length && CHAOS_HEADER_FIELD == CHAOS_HEADER) {
+		if (CHAOS_SYNC_MODE && estimate_length && CHAOS_HEADER_KIND(CHAOS_HEADER_FIELD) == CHAOS_HEADER) {
 			estimate_slot_length(t_rx_stop_tmp);
 		}
 		t_rx_stop = t_rx_stop_tmp;
-		*(chaos_data_struct*)data = *(chaos_data_struct*)(&CHAOS_DATA_FIELD);
+		// the merged packet holds the local data from now on
+		data = &CHAOS_DATA_FIELD;
 #if FINAL_CHAOS_FLOOD
 		if( chaos_complete == CHAOS_COMPLETE ){
 			tx_cnt_complete++;
@@ -847,6 +2128,24 @@ inline void chaos_end_rx(void) {
 #endif /* LOG_FLAGS */
 	} else {
 		radio_flush_rx();
+#if CHAOS_FEC
+		if (fec_repaired) {
+			// the repaired packet holds the local data from now on, the TXFIFO does not
+			data = &CHAOS_DATA_FIELD;
+			fec_repaired = 0;
+			if (CHAOS_RX_CNT() == 0) {
+				// first successful reception: store current time
+				t_first_rx_l = RTIMER_NOW();
+			}
+			// a reception all the same, but neither timed nor relayed: rx_cnt drives the
+			// reference time and the slot length
+			fec_rx_cnt++;
+#if CHAOS_TXFIFO_PATCH
+			txfifo_loaded = 0;
+#endif /* CHAOS_TXFIFO_PATCH */
+		}
+#endif /* CHAOS_FEC */
+		packet_use_local();
 		state = CHAOS_STATE_WAITING;
 	}
 }
@@ -855,9 +2154,11 @@ inline void chaos_begin_tx(void) {
 	SET_PIN_ADC2;
 	t_tx_start = TBCCR1;
 	state = CHAOS_STATE_TRANSMITTING;
-	tx_relay_cnt_last = CHAOS_RELAY_CNT_FIELD;
-	// relay counter to be used in case the timeout expires
-	relay_cnt_timeout = CHAOS_RELAY_CNT_FIELD + n_slots_timeout;
+	if (CHAOS_SYNC_MODE) {
+		tx_relay_cnt_last = CHAOS_RELAY_CNT_FIELD;
+		// relay counter to be used in case the timeout expires
+		relay_cnt_timeout = CHAOS_RELAY_CNT_FIELD + n_slots_timeout;
+	}
 
 	if ((CHAOS_SYNC_MODE) && (T_slot_h) && (!t_ref_l_updated) && (rx_cnt)) {
 		// compute the reference time after the first reception (higher accuracy)
@@ -891,25 +2192,46 @@ inline void chaos_end_tx(void) {
 	ENERGEST_OFF(ENERGEST_TYPE_TRANSMIT);
 	ENERGEST_ON(ENERGEST_TYPE_LISTEN);
 	t_tx_stop = TBCCR1;
+#if CHAOS_HOPPING && CHAOS_HOP_RELAYS
+	// listen for the next relay on its channel
+	if (chaos_hop(tx_relay_cnt_last + 1)) {
+		FASTSPI_STROBE(CC2420_SRXON);
+	}
+#endif /* CHAOS_HOPPING && CHAOS_HOP_RELAYS */
 	// stop Chaos if tx_cnt reached tx_max (and tx_max > 1 at the initiator, if sync is enabled)
 	if ((++tx_cnt == tx_max) && ((!CHAOS_SYNC_MODE) || ((tx_max - initiator) > 0))) {
 		radio_off();
 		state = CHAOS_STATE_OFF;
 #if FINAL_CHAOS_FLOOD
 	} else if ( chaos_complete == CHAOS_COMPLETE && tx_cnt_complete >= N_TX_COMPLETE ){
-		radio_off();
-		state = CHAOS_STATE_OFF;
+#if CHAOS_BURST > 1
+		if (burst_round + 1 < CHAOS_BURST) {
+			// done with this logical round: keep the radio on for the next one
+			chaos_burst_next();
+		} else
+#endif /* CHAOS_BURST */
+		{
+			radio_off();
+			state = CHAOS_STATE_OFF;
+		}
 #endif /* FINAL_CHAOS_FLOOD */
+#if CHAOS_BURST > 1
+	} else if (initiator && ++burst_tx >= CHAOS_BURST_ROUND_TX && burst_round + 1 < CHAOS_BURST) {
+		// the round does not complete: do not hold back the next ones
+		chaos_burst_next();
+#endif /* CHAOS_BURST */
 	} else {
 		state = CHAOS_STATE_WAITING;
 	}
+#if !CHAOS_TXFIFO_PATCH
 	radio_flush_tx();
+#endif /* CHAOS_TXFIFO_PATCH */
 }
 
 /* ------------------------------ Timeouts -------------------------- */
 #ifdef LOG_TIRQ
 inline void print_tirq(void){
-	printf("win_cnt %u, T_slot_tmp %u\n", win_cnt, (uint16_t)(T_slot_h_sum / win_cnt));
+	printf("slot_n %u, T_slot_h %u\n", slot_n, T_slot_h);
 	printf("tirq %02x:", tirq_log_cnt);
 	uint8_t i;
 	for( i = 0; i < tirq_log_cnt; i++ ){
@@ -52,6 +52,7 @@
 #include <stdio.h>
 #include <legacymsp430.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include "lib/random.h"
 
 /**
@@ -70,9 +71,41 @@
 //#define LOG_ALL_FLAGS 1
 
 /**
- * Size of the window used to average estimations of slot lengths.
+ * Size of the window used to average estimations of slot lengths: the filter
+ * weighs the n-th observation 1/n, and never less than 1/CHAOS_SYNC_WINDOW.
  */
+#ifndef CHAOS_SYNC_WINDOW
 #define CHAOS_SYNC_WINDOW             32
+#endif
+
+/**
+ * Observations of the slot length whose running median feeds the filter (odd,
+ * at most 7): a single outlier from a captured or late packet never gets through.
+ */
+#ifndef CHAOS_SLOT_MEDIAN
+#define CHAOS_SLOT_MEDIAN             5
+#endif
+
+/**
+ * Once the filter has settled, medians further than this from the estimate (in DCO ticks)
+ * are ignored, unless CHAOS_SLOT_MEDIAN of them in a row show that the slot length changed.
+ */
+#ifndef CHAOS_SLOT_GATE
+#define CHAOS_SLOT_GATE               64
+#endif
+
+/**
+ * Highest number of slots between the reception preceding our last transmission and
+ * a later one still used to estimate the slot length: at least 2 (the reception right
+ * after our transmission), at most 3 to keep each interval within 16 bits.
+ */
+#ifndef CHAOS_SLOT_MAX_SPAN
+#define CHAOS_SLOT_MAX_SPAN           2
+#endif
+
+#if CHAOS_SLOT_MAX_SPAN < 2 || CHAOS_SLOT_MAX_SPAN > 3
+#error "CHAOS_SLOT_MAX_SPAN: 2 (baseline) or 3 slots"
+#endif
 
 #ifndef FINAL_CHAOS_FLOOD
 #define FINAL_CHAOS_FLOOD              1 // are the final Chaos floods enabled?
@@ -94,7 +127,94 @@
 #define CC2420_TXPOWER CC2420_TXPOWER_MAX
 #endif
 
-#define BYTES_TIMEOUT                  32
+#ifndef CHAOS_TXFIFO_PATCH
+#define CHAOS_TXFIFO_PATCH              0 // update only modified bytes of the TXFIFO after a merge?
+#endif
+
+#ifndef CHAOS_HOPPING
+#define CHAOS_HOPPING                   0 // is channel hopping across rounds enabled?
+#endif
+
+#ifndef CHAOS_HOP_RELAYS
+#define CHAOS_HOP_RELAYS                0 // relay counts per channel within a round, 0: no hops within a round
+#endif
+
+#ifndef CHAOS_HEADER_VERSION
+#define CHAOS_HEADER_VERSION            0 // 0: legacy one-byte header, 1 to 6: versioned two-byte header (see CHAOS_HEADER)
+#endif
+
+#ifndef CHAOS_FEC
+#define CHAOS_FEC                       0 // use packets failing the hardware CRC if per-section CRCs and parity can repair them?
+#endif
+
+#ifndef CHAOS_FEC_SECTIONS
+#define CHAOS_FEC_SECTIONS              8 // sections of the data, each with a CRC-16: one of them can be rebuilt
+#endif
+
+#ifndef CHAOS_FLAGS_CRC
+#define CHAOS_FLAGS_CRC                 0 // merge the flags of packets failing the hardware CRC if their own CRC-16 checks out?
+#endif
+
+#ifndef CHAOS_BURST
+#define CHAOS_BURST                     1 // logical rounds chained in one Chaos phase, 1: no bursts
+#endif
+
+#ifndef CHAOS_BURST_HOOK_CYCLES
+#define CHAOS_BURST_HOOK_CYCLES         (PAYLOAD_LEN * 10 + 200) // estimated DCO cycles of the burst hook, part of PROCESSING_CYCLES
+#endif
+
+#ifndef CHAOS_BURST_ROUND_TX
+#define CHAOS_BURST_ROUND_TX            20 // initiator transmissions after which it starts the next logical round anyway
+#endif
+
+/**
+ * Low-power listening, used to wake up the network before event-triggered
+ * rounds in \link CHAOS_NO_SYNC \endlink mode: sleeping nodes check the channel
+ * for CHAOS_LPL_LISTEN every CHAOS_LPL_INTERVAL, the initiator sends wake-up
+ * frames for longer than that before starting the flood.
+ */
+#ifndef CHAOS_LPL_INTERVAL
+#define CHAOS_LPL_INTERVAL           (RTIMER_SECOND / 4)      // 250 ms
+#endif
+
+#ifndef CHAOS_LPL_LISTEN
+#define CHAOS_LPL_LISTEN             (RTIMER_SECOND / 500)    // 2 ms, several wake-up frames
+#endif
+
+#ifndef CHAOS_WAKEUP_GAP
+#define CHAOS_WAKEUP_GAP             (RTIMER_SECOND / 2000)   // 0.5 ms between wake-up frames, the CPU is free meanwhile
+#endif
+
+#define CHAOS_WAKEUP_FRAME_TIME      (RTIMER_SECOND / 1000)   // 1 ms, bounds the wait for a wake-up frame (about 0.5 ms)
+
+/**
+ * Fast join, used to skip bootstrapping in \link CHAOS_SYNC \endlink mode: a node
+ * that knows nothing of the schedule sends join requests, synced nodes listen for
+ * them for CHAOS_JOIN_LISTEN after some of their rounds and answer with a join reply
+ * carrying the schedule (see \link chaos_join \endlink).
+ */
+#ifndef CHAOS_JOIN_LISTEN
+#define CHAOS_JOIN_LISTEN            (RTIMER_SECOND / 100)    // 10 ms, a few requests
+#endif
+
+#ifndef CHAOS_JOIN_REPLY_WAIT
+#define CHAOS_JOIN_REPLY_WAIT        (RTIMER_SECOND / 1000)   // 1 ms, reception of a request and turnaround
+#endif
+
+#ifndef CHAOS_JOIN_QUIET
+#define CHAOS_JOIN_QUIET             (RTIMER_SECOND / 500)    // 2 ms without packets of a round before requesting
+#endif
+
+#define CHAOS_JOIN_TX_DELAY          (RTIMER_SECOND * 366uL / 1000000uL) // from computing the reply to its SFD: SPI, calibration, preamble
+#define CHAOS_JOIN_FRAME_TIME        (RTIMER_SECOND / 200)    // 5 ms, bounds the wait for the end of any frame (127 bytes: 4.1 ms)
+
+/**
+ * Channels used for hopping (not overlapping with WiFi channels 1, 6 and 11).
+ * The first one is used by nodes that do not know the current round yet.
+ */
+#ifndef CHAOS_HOP_CHANNELS
+#define CHAOS_HOP_CHANNELS           {RF_CHANNEL, 15, 25, 20}
+#endif
 
 /**
  * Ratio between the frequencies of the DCO and the low-frequency clocks
@@ -105,25 +225,85 @@
 #define CLOCK_PHI                     (F_CPU / RTIMER_SECOND)
 #endif /* COOJA */
 
+#if CHAOS_HEADER_VERSION
+/**
+ * Versioned header, two bytes of bitfields parsed while the packet is being received:
+ * - first byte: version (3 bits), reserved, timeout, round id of bursts (3 bits);
+ * - second byte: merge operator (3 bits), encoding (2 bits), segment number (3 bits).
+ * Receptions of another version, operator or encoding are aborted right after the header.
+ * The legacy header reads as version 7, and legacy nodes reject any other version.
+ */
+#define CHAOS_HEADER                 (CHAOS_HEADER_VERSION << 5)
+#define CHAOS_HEADER_VERSION_MASK    0xe0
+#define CHAOS_HEADER_TIMEOUT_BIT     0x08
+#define CHAOS_HEADER_ROUND_MASK      0x07
+#define CHAOS_HEADER_TIMEOUT         (CHAOS_HEADER | CHAOS_HEADER_TIMEOUT_BIT) // sent on timeout or once complete: do not estimate the slot length
+#define CHAOS_HEADER_OK(h)           (((h) & CHAOS_HEADER_VERSION_MASK) == CHAOS_HEADER)
+#define CHAOS_HEADER_KIND(h)         ((h) & ~CHAOS_HEADER_ROUND_MASK)
+#define CHAOS_ENCODING_FEC           0x01
+#define CHAOS_ENCODING_FLAGS_CRC     0x02
+#define CHAOS_ENCODING               ((CHAOS_FEC ? CHAOS_ENCODING_FEC : 0) | \
+		(CHAOS_FLAGS_CRC ? CHAOS_ENCODING_FLAGS_CRC : 0))
+#define CHAOS_HEADER_EXT             ((CHAOS_MERGE_OP << 5) | (CHAOS_ENCODING << 3)) // segment 0
+#define CHAOS_HEADER_EXT_MASK        0xf8 // must match: operator and encoding
+#define CHAOS_HEADER_SEGMENT_MASK    0x07
+#define CHAOS_HEADER_LEN             (2 * sizeof(uint8_t))
+#else
 #define CHAOS_HEADER                 0xfe
+#define CHAOS_HEADER_TIMEOUT         (CHAOS_HEADER+1) // sent on timeout or once complete: do not estimate the slot length
+#define CHAOS_HEADER_OK(h)           ((h) >= CHAOS_HEADER)
+#define CHAOS_HEADER_KIND(h)         (h)
 #define CHAOS_HEADER_LEN             sizeof(uint8_t)
+#endif /* CHAOS_HEADER_VERSION */
 #define CHAOS_RELAY_CNT_LEN          sizeof(uint8_t)
+#if CHAOS_BURST > 1 && !CHAOS_HEADER_VERSION
+#define CHAOS_ROUND_LEN              sizeof(uint8_t)
+#else
+#define CHAOS_ROUND_LEN              0 // no bursts, or round id in the versioned header
+#endif /* CHAOS_BURST */
+#if CHAOS_FEC
+#define CHAOS_FEC_COVERED            (DATA_LEN + CHAOS_ROUND_LEN) // data and round number
+#define CHAOS_FEC_SECTION_LEN        ((CHAOS_FEC_COVERED + CHAOS_FEC_SECTIONS - 1) / CHAOS_FEC_SECTIONS)
+#define CHAOS_FEC_LEN                (2 * CHAOS_FEC_SECTIONS + CHAOS_FEC_SECTION_LEN) // CRCs, then parity
+#else
+#define CHAOS_FEC_LEN                0
+#endif /* CHAOS_FEC */
+#if CHAOS_FLAGS_CRC
+#define CHAOS_FLAGS_CRC_LEN          sizeof(uint16_t)
+#define CHAOS_FLAGS_CRC_OFFSET       (DATA_LEN + CHAOS_ROUND_LEN + CHAOS_FEC_LEN) // from the data
+#else
+#define CHAOS_FLAGS_CRC_LEN          0
+#endif /* CHAOS_FLAGS_CRC */
 #define CHAOS_IS_ON()                (get_state() != CHAOS_STATE_OFF)
 #define FOOTER_LEN                    2
 #define FOOTER1_CRC_OK                0x80
 #define FOOTER1_CORRELATION           0x7f
 
 
-#if CHAOS_SYNC_MODE == CHAOS_SYNC
-#define PACKET_LEN (DATA_LEN + FOOTER_LEN + CHAOS_RELAY_CNT_LEN + CHAOS_HEADER_LEN)
-#else
-#define PACKET_LEN (DATA_LEN + FOOTER_LEN + CHAOS_HEADER_LEN)
-#endif
+// without synchronization there is no relay counter
+#define PACKET_LEN (DATA_LEN + CHAOS_ROUND_LEN + CHAOS_FEC_LEN + CHAOS_FLAGS_CRC_LEN + FOOTER_LEN + \
+		((CHAOS_SYNC_MODE) ? CHAOS_RELAY_CNT_LEN : 0) + CHAOS_HEADER_LEN)
+#define CHAOS_WAKEUP_LEN             (CHAOS_HEADER_LEN + FOOTER_LEN)
+// join frames: header rejected by rounds of any header version, kind, schedule of replies
+#define CHAOS_JOIN_HEADER            0xfc
+#define CHAOS_JOIN_REQUEST           0x01
+#define CHAOS_JOIN_REPLY             0x02
+#define CHAOS_JOIN_REQUEST_LEN       (2 + FOOTER_LEN)
+#define CHAOS_JOIN_REPLY_LEN         (2 + sizeof(chaos_join_info) + FOOTER_LEN)
 
+#define CHAOS_DATA_OFFSET            (1 + CHAOS_HEADER_LEN)
 #define CHAOS_LEN_FIELD              packet[0]
 #define CHAOS_HEADER_FIELD           packet[1]
-#define CHAOS_DATA_FIELD             packet[2]
-#define CHAOS_BYTES_TIMEOUT_FIELD    packet[2+BYTES_TIMEOUT]
+#define CHAOS_HEADER_EXT_FIELD       packet[2]
+#define CHAOS_DATA_FIELD             packet[CHAOS_DATA_OFFSET]
+#define CHAOS_ROUND_FIELD            packet[CHAOS_DATA_OFFSET + DATA_LEN]
+#if CHAOS_HEADER_VERSION
+#define CHAOS_ROUND()                (CHAOS_HEADER_FIELD & CHAOS_HEADER_ROUND_MASK)
+#else
+#define CHAOS_ROUND()                CHAOS_ROUND_FIELD
+#endif /* CHAOS_HEADER_VERSION */
+#define CHAOS_FEC_FIELD              packet[CHAOS_DATA_OFFSET + DATA_LEN + CHAOS_ROUND_LEN]
+#define CHAOS_FLAGS_CRC_FIELD        packet[CHAOS_DATA_OFFSET + DATA_LEN + CHAOS_ROUND_LEN + CHAOS_FEC_LEN]
 #define CHAOS_RELAY_CNT_FIELD        packet[PACKET_LEN - FOOTER_LEN]
 #define CHAOS_RSSI_FIELD             packet[PACKET_LEN - 1]
 #define CHAOS_CRC_FIELD              packet[PACKET_LEN]
@@ -132,14 +312,50 @@ enum {
 	CHAOS_INITIATOR = 1, CHAOS_RECEIVER = 0
 };
 
-enum {
-	CHAOS_SYNC = 1, CHAOS_NO_SYNC = 0
-};
+/**
+ * Synchronization modes (see CHAOS_SYNC_MODE).
+ */
+#define CHAOS_SYNC                   1 /**< relay counter and slot estimation, periodic rounds */
+#define CHAOS_NO_SYNC                0 /**< no relay counter, event-triggered rounds */
 
 enum {
 	CHAOS_COMPLETE = 1, CHAOS_INCOMPLETE = 0
 };
 
+/**
+ * Merge operators for the payload, applied chunk by chunk
+ * (see \link CHAOS_MERGE_OP \endlink).
+ */
+#define CHAOS_MERGE_NONE 0 /**< the received payload replaces the local one */
+#define CHAOS_MERGE_OR   1 /**< bitwise OR */
+#define CHAOS_MERGE_MAX  2 /**< byte-wise maximum */
+#define CHAOS_MERGE_TOPK 3 /**< k highest values with node indexes, see \link chaos_topk_entry \endlink */
+#define CHAOS_MERGE_HIST 4 /**< histogram, one node bitmap per bucket merged by bitwise OR */
+#define CHAOS_MERGE_XOR  5 /**< dissemination of an object network-coded over GF(2), see chaos-nc.h */
+#define CHAOS_MERGE_MUX  6 /**< several sections, each with its own operator, see \link chaos_mux_section \endlink */
+
+/**
+ * Completion rules of the sections of \link CHAOS_MERGE_MUX \endlink.
+ */
+#define CHAOS_MUX_DONE_FLAGS 0 /**< done when the flags are: every node contributed */
+#define CHAOS_MUX_DONE_FULL  1 /**< a node bitmap of MERGE_LEN bytes, done when every bit is set */
+
+/**
+ * \brief Section of the payload merged by CHAOS_MERGE_MUX.
+ */
+typedef struct {
+	uint8_t offset; /**< First byte in the payload. */
+	uint8_t len;    /**< Length in bytes. */
+	uint8_t op;     /**< Merge operator: CHAOS_MERGE_NONE, CHAOS_MERGE_OR or CHAOS_MERGE_MAX. */
+	uint8_t done;   /**< Completion rule, CHAOS_MUX_DONE_FLAGS or CHAOS_MUX_DONE_FULL. */
+} chaos_mux_section;
+
+/**
+ * Sections of the payload, CHAOS_MUX_SECTIONS as merged by Chaos (with CHAOS_MERGE_MUX only).
+ */
+extern const chaos_mux_section chaos_mux_sections[];
+extern const uint8_t chaos_mux_sections_n; /**< Number of entries of chaos_mux_sections. */
+
 /**
  * List of possible Chaos states.
  */
@@ -152,11 +368,22 @@ enum chaos_state {
 	CHAOS_STATE_TRANSMITTED,  /**< Chaos has just finished transmitting a packet */
 	CHAOS_STATE_ABORTED       /**< Chaos has just aborted a packet reception */
 };
+/**
+ * Schedule carried by join replies (see \link chaos_join \endlink).
+ */
+typedef struct {
+	unsigned long seq_no; /**< Sequence number of the last round. */
+	uint32_t period;      /**< Period of the rounds, in rtimer ticks. */
+	int16_t skew;         /**< Clock skew of the answering node over a period, in rtimer ticks. */
+	uint16_t t_since_ref; /**< Rtimer ticks from the reference time of the last round to the SFD of the reply. */
+} chaos_join_info;
+
 #if CHAOS_DEBUG
-unsigned int high_T_irq, rx_timeout, bad_length, bad_header, bad_crc, rc_update;
+unsigned int high_T_irq, rx_timeout, bad_length, bad_header, bad_crc, rc_update, fec_rescued, flags_rescued;
 #endif /* CHAOS_DEBUG */
 
 PROCESS_NAME(chaos_process);
+PROCESS_NAME(chaos_join_process);
 
 /* ----------------------- Application interface -------------------- */
 /**
@@ -172,24 +399,44 @@ PROCESS_NAME(chaos_process);
  */
 
 /**
- * \brief            Start Chaos and stall all other application tasks.
+ * \brief            Get the flooding data.
+ * \returns          A pointer to the flooding data, kept in place inside the
+ *                   Chaos packet buffer.
  *
- * \param data_      A pointer to the flooding data.
- *
- *                   At the initiator, Chaos reads from the given memory
- *                   location data provided by the application.
+ *                   Before \link chaos_start \endlink, the application writes its
+ *                   data there. During a Chaos phase, Chaos merges received data
+ *                   into it. The location changes with every successful merge:
+ *                   do not keep the pointer across Chaos phases.
+ */
+uint8_t *chaos_get_data(void);
+
+/**
+ * \brief            Start Chaos and stall all other application tasks.
  *
- *                   At a receiver, Chaos writes to the given memory
- *                   location data for the application.
- * \param data_len_  Length of the flooding data, in bytes.
+ *                   The flooding data is the one at \link chaos_get_data \endlink.
  * \param initiator_ Not zero if the node is the initiator,
  *                   zero if it is a receiver.
  * \param sync_      Not zero if Chaos must provide time synchronization,
  *                   zero otherwise.
  * \param tx_max_    Maximum number of transmissions (N).
  */
-void chaos_start(uint8_t *data_, /*uint8_t data_len_,*/ uint8_t initiator_,
-		/*uint8_t sync_,*/ uint8_t tx_max_);
+void chaos_start(uint8_t initiator_, /*uint8_t sync_,*/ uint8_t tx_max_);
+
+/**
+ * \brief            Start a flood from a node that called \link chaos_start \endlink
+ *                   as a receiver and has not received anything yet.
+ *
+ *                   Used to start a round without a dedicated initiator:
+ *                   all nodes calling it at the same time transmit with the
+ *                   same relay counter, so concurrent starts are
+ *                   indistinguishable from a single one for the receivers.
+ * \param relay_cnt  Relay counter of the first transmission: slots elapsed
+ *                   since the reference time, so that receivers compute the
+ *                   same reference time as for a start right at it.
+ * \returns          Not zero if the flood has been started, zero if a packet
+ *                   has already been received (the node keeps relaying it).
+ */
+uint8_t chaos_initiate(uint8_t relay_cnt);
 
 /**
  * \brief            Stop Chaos and resume all other application tasks.
@@ -200,6 +447,104 @@ void chaos_start(uint8_t *data_, /*uint8_t data_len_,*/ uint8_t initiator_,
  */
 uint8_t chaos_stop(void);
 
+/**
+ * \brief            Register a function called when Chaos turns itself off,
+ *                   i.e., when the node is done with the current round before
+ *                   \link chaos_stop \endlink is called.
+ *
+ *                   The function is called by \link chaos_process \endlink with
+ *                   interrupts disabled; it typically ends the Chaos phase early
+ *                   (see \link rtimer_advance \endlink).
+ * \param hook       Function to be called, NULL to disable.
+ */
+void chaos_set_off_hook(void (*hook)(void));
+
+/**
+ * \brief            Register a function called when the node moves to the next
+ *                   logical round of a burst (see \link CHAOS_BURST \endlink).
+ *
+ *                   Within one Chaos phase, the initiator starts logical round
+ *                   r + 1 when it is done with round r, reusing the slot timing of
+ *                   the phase; the other nodes move to round r + 1 when they receive
+ *                   it. The function is called from the SFD interrupt, within the
+ *                   \link PROCESSING_CYCLES \endlink budget (its share is
+ *                   CHAOS_BURST_HOOK_CYCLES): the flooding data still
+ *                   holds the outcome of round r, the function takes what it needs
+ *                   and writes the contribution of the node to round r + 1 in place.
+ * \param hook       Function to be called with the new round and the flooding data,
+ *                   NULL to disable.
+ */
+void chaos_set_burst_hook(void (*hook)(uint8_t round, uint8_t *data));
+
+/**
+ * \brief            Send one wake-up frame to nodes doing low-power listening.
+ *
+ *                   Call it every \link CHAOS_WAKEUP_GAP \endlink, from an rtimer
+ *                   callback, for longer than \link CHAOS_LPL_INTERVAL \endlink, then
+ *                   \link chaos_wakeup_end \endlink before \link chaos_start \endlink.
+ *                   Waits at most \link CHAOS_WAKEUP_FRAME_TIME \endlink.
+ */
+void chaos_wakeup(void);
+
+/**
+ * \brief            End a train of wake-up frames.
+ */
+void chaos_wakeup_end(void);
+
+/**
+ * \brief            Check the channel for wake-up frames, for
+ *                   \link CHAOS_LPL_LISTEN \endlink, with the radio off otherwise.
+ * \returns          Not zero if a wake-up frame (length, header and CRC) was heard:
+ *                   the node should start Chaos as a receiver right away.
+ */
+uint8_t chaos_lpl_check(void);
+
+/**
+ * \brief            Start asking synced neighbors for the schedule: send join
+ *                   requests and listen for a join reply in between, until one
+ *                   arrives or until t_stop. Requests pause while packets of a
+ *                   round are on the channel, the neighbors answer when it is over.
+ *
+ *                   Called from an rtimer callback: the requests are sent by
+ *                   chaos_join_process, on RF_CHANNEL, with interrupts enabled.
+ *                   Schedule an rtimer at t_stop and end with \link chaos_join_end \endlink.
+ *                   On success the reference time is the one of the last round
+ *                   of the answering node (see \link get_t_ref_l \endlink and
+ *                   \link is_t_ref_l_updated \endlink).
+ * \param t_stop     Time to give up at, in rtimer ticks.
+ */
+void chaos_join(rtimer_clock_t t_stop);
+
+/**
+ * \brief            Start answering join requests, after a round of a synced node.
+ *
+ *                   Called from an rtimer callback: chaos_join_process listens
+ *                   until t_stop, usually \link CHAOS_JOIN_LISTEN \endlink later,
+ *                   on RF_CHANNEL, and answers about one request in two: replies
+ *                   of several neighbors collide less often. Schedule an rtimer at
+ *                   t_stop and end with \link chaos_join_end \endlink.
+ * \param t_stop     Time to stop listening at, in rtimer ticks.
+ * \param info       Schedule of the node. The time since the reference time
+ *                   is filled in for each reply.
+ */
+void chaos_join_serve(rtimer_clock_t t_stop, const chaos_join_info *info);
+
+/**
+ * \brief            End the window started by \link chaos_join \endlink or
+ *                   \link chaos_join_serve \endlink, from the rtimer callback
+ *                   at its t_stop: chaos_join_process leaves it and turns the
+ *                   radio off.
+ * \param info       Filled with the schedule of the answering node, if any.
+ *                   NULL after \link chaos_join_serve \endlink.
+ * \returns          Not zero if a reply arrived, or the number of replies sent.
+ */
+uint8_t chaos_join_end(chaos_join_info *info);
+
+/**
+ * \brief            Get the logical round of the burst the node is in.
+ */
+uint8_t get_burst_round(void);
+
 /**
  * \brief            Get the last received counter.
  * \returns          Number of times the packet has been received during
@@ -208,6 +553,12 @@ uint8_t chaos_stop(void);
  */
 uint8_t get_rx_cnt(void);
 
+/**
+ * \brief            Get the number of receptions with a bad CRC.
+ * \returns          Packets received with a bad CRC during last Chaos phase.
+ */
+uint8_t get_crc_err_cnt(void);
+
 /**
  * \brief            Get the current Chaos state.
  * \return           Current Chaos state, one of the possible values
@@ -223,6 +574,46 @@ uint8_t get_state(void);
  */
 rtimer_clock_t get_t_first_rx_l(void);
 
+/**
+ * \brief            Check if all flags were set during the last Chaos phase.
+ * \returns          \link CHAOS_COMPLETE \endlink or \link CHAOS_INCOMPLETE \endlink.
+ */
+uint8_t get_complete(void);
+
+/**
+ * \brief            Get low-frequency time of the first reception with all flags
+ *                   set during the last Chaos phase.
+ * \returns          Low-frequency time of completion, only valid if
+ *                   \link get_complete \endlink returns \link CHAOS_COMPLETE \endlink.
+ */
+rtimer_clock_t get_t_complete_l(void);
+
+/**
+ * \brief            Select the channel of the next Chaos phases, when
+ *                   \link CHAOS_HOPPING \endlink is off.
+ *                   Must be called before \link chaos_start \endlink.
+ * \param channel    IEEE 802.15.4 channel (11 to 26), RF_CHANNEL by default.
+ */
+void chaos_set_channel(uint8_t channel);
+
+/**
+ * \brief            Select the transmit power of the next Chaos phases,
+ *                   applied by \link chaos_start \endlink.
+ * \param power      PA_LEVEL of the CC2420 (3 to 31), CC2420_TXPOWER by default.
+ */
+void chaos_set_tx_power(uint8_t power);
+
+/**
+ * \brief            Select the hopping sequence for the next Chaos phase.
+ *                   Must be called before \link chaos_start \endlink.
+ * \param seq_no     Sequence number of the next round. All nodes using the same
+ *                   sequence number start on the same channel and, if
+ *                   \link CHAOS_HOP_RELAYS \endlink is not zero, hop at the same
+ *                   relay counters. Sequence number zero starts on the first
+ *                   entry of \link CHAOS_HOP_CHANNELS \endlink.
+ */
+void chaos_set_hop_seq_no(unsigned long seq_no);
+
 /** @} */
 
 /**
@@ -250,6 +641,14 @@ rtimer_clock_t get_T_slot_h(void);
  */
 rtimer_clock_t get_t_ref_l(void);
 
+/**
+ * \brief            Get the sub-tick offset of the reference time.
+ * \returns          DCO clock ticks, minus one, between the low-frequency tick
+ *                   \link get_t_ref_l \endlink and the actual reference time
+ *                   (between 0 and CLOCK_PHI - 1).
+ */
+rtimer_clock_t get_T_offset_h(void);
+
 /**
  * \brief            Provide information about current synchronization status.
  * \returns          Not zero if the synchronization reference time was
@@ -120,6 +120,18 @@ rtimer_set_long(struct rtimer *rtimer, rtimer_clock_t ref_time, unsigned long of
   return RTIMER_OK;
 }
 /*---------------------------------------------------------------------------*/
+int
+rtimer_advance(struct rtimer *rtimer, rtimer_clock_t time)
+{
+  if(next_rtimer != rtimer) {
+    return 0;
+  }
+  rtimer->overflows_to_go = 0;
+  rtimer->time = time;
+  rtimer_arch_schedule(time);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 unsigned long
 rtimer_time_to_expire(void) {
 	return (unsigned long)(TACCR0 - RTIMER_NOW()) +
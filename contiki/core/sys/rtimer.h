@@ -113,6 +113,15 @@ int rtimer_set_long(struct rtimer *task, rtimer_clock_t ref_time, unsigned long
 	       rtimer_callback_t func, void *ptr);
 unsigned long rtimer_time_to_expire(void);
 
+/**
+ * \brief      Move a pending real-time task to an earlier time
+ * \param task A pointer to the task variable, currently scheduled.
+ * \param time The new time when the task is to be executed.
+ * \return     Non-zero (true) if the task was pending and has been moved,
+ *             zero (false) otherwise.
+ */
+int rtimer_advance(struct rtimer *task, rtimer_clock_t time);
+
 /**
  * \brief      Execute the next real-time task and schedule the next task, if any
  *